@@ -16,8 +16,17 @@
 
 #include "RangeAnalysis.h"
 
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
 using namespace llvm;
 
+static cl::opt<unsigned> RAThreads("ra-threads",
+  cl::desc("Number of threads building the constraint graphs of the "
+           "functions in the inter-procedural analysis"),
+  cl::init(1));
+
 // These macros are used to get stats regarding the precision of our analysis.
 STATISTIC(usedBits, "Initial number of bits.");
 STATISTIC(needBits, "Needed bits.");
@@ -55,6 +64,32 @@ APInt Min = APInt::getSignedMinValue(MAX_BIT_INT);
 APInt Max = APInt::getSignedMaxValue(MAX_BIT_INT);
 APInt Zero(MAX_BIT_INT, 0, true);
 
+// Keeps the low width bits of v, sign extended, which is the value an APInt
+// of that width would hold
+static inline int64_t wrapToWidth(__int128 v, unsigned width) {
+  unsigned shift = 128 - width;
+  return (int64_t)((__int128)((unsigned __int128)v << shift) >> shift);
+}
+
+// Same as MUL_HELPER and MUL_OV below, with the limits of the width
+static inline int64_t mulHelper(int64_t x, int64_t y, int64_t min,
+                                int64_t max, unsigned width) {
+  if (x == max)
+    return y < 0 ? min : (y == 0 ? 0 : max);
+  if (y == max)
+    return x < 0 ? min : (x == 0 ? 0 : max);
+  if (x == min)
+    return y < 0 ? max : (y == 0 ? 0 : min);
+  if (y == min)
+    return x < 0 ? max : (x == 0 ? 0 : min);
+  return wrapToWidth((__int128)x * y, width);
+}
+
+static inline int64_t mulOverflow(int64_t x, int64_t y, int64_t xy,
+                                  int64_t min, int64_t max) {
+  return (x > 0) == (y > 0) ? (xy < 0 ? max : xy) : (xy > 0 ? min : xy);
+}
+
 // String used to identify sigmas
 // IMPORTANT: the range-analysis identifies sigmas by comparing
 // to this hard-coded instruction name prefix.
@@ -69,6 +104,136 @@ raw_string_ostream pseudoEdgesString(pestring);
 Profile prof;
 #endif
 
+// ========================================================================== //
+// Profile
+// ========================================================================== //
+size_t Profile::getPeakRSS() {
+#if defined(__unix__) || defined(__APPLE__)
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) == 0)
+#ifdef __APPLE__
+    return usage.ru_maxrss;
+#else
+    return (size_t)usage.ru_maxrss * 1024;
+#endif
+#endif
+  return sys::Process::GetMallocUsage();
+}
+
+void Profile::Histogram::reset() {
+  std::fill(buckets, buckets + 64, 0);
+  count = 0;
+  total = 0;
+}
+
+void Profile::Histogram::add(uint64_t nanoseconds) {
+  buckets[nanoseconds > 1 ? Log2_64(nanoseconds) : 0]++;
+  count++;
+  total += nanoseconds;
+}
+
+void Profile::Histogram::merge(const Histogram &Other) {
+  for (unsigned b = 0; b != 64; ++b)
+    buckets[b] += Other.buckets[b];
+  count += Other.count;
+  total += Other.total;
+}
+
+uint64_t Profile::Histogram::getPercentile(double p) const {
+  uint64_t rank = (uint64_t)(p * count), seen = 0;
+  for (unsigned b = 0; b != 63; ++b) {
+    seen += buckets[b];
+    if (seen > rank)
+      return (uint64_t)2 << b;
+  }
+  return ~(uint64_t)0;
+}
+
+Profile::Phase &Profile::getPhase(StringRef key) {
+  auto it = phases.find(key);
+  if (it == phases.end()) {
+    it = phases.insert(std::make_pair(key, Phase())).first;
+    phaseOrder.push_back(it->first());
+  }
+  return it->second;
+}
+
+void Profile::updatePhase(StringRef key, uint64_t nanoseconds) {
+  Phase &P = getPhase(key);
+  P.nanoseconds += nanoseconds;
+  P.peakRSS = getPeakRSS();
+}
+
+Profile::Histogram &Profile::getHistogram(StringRef key) {
+  auto it = histograms.find(key);
+  if (it == histograms.end()) {
+    it = histograms.insert(std::make_pair(key, Histogram())).first;
+    histogramOrder.push_back(it->first());
+  }
+  return it->second;
+}
+
+void Profile::resetPhases() {
+  for (auto &P : phases)
+    P.second = Phase();
+  for (auto &H : histograms)
+    H.second.reset();
+}
+
+void Profile::addPhases(const Profile &Other) {
+  for (StringRef key : Other.phaseOrder) {
+    const Phase &O = Other.phases.find(key)->second;
+    Phase &P = getPhase(key);
+    P.nanoseconds += O.nanoseconds;
+    P.peakRSS = std::max(P.peakRSS, O.peakRSS);
+  }
+  for (StringRef key : Other.histogramOrder)
+    getHistogram(key).merge(Other.histograms.find(key)->second);
+}
+
+uint64_t Profile::getTotalNanoseconds() const {
+  uint64_t total = 0;
+  for (auto &P : phases)
+    total += P.second.nanoseconds;
+  for (auto &H : histograms)
+    total += H.second.getTotal();
+  return total;
+}
+
+void Profile::printPhases(raw_ostream &OS) const {
+  for (StringRef key : phaseOrder) {
+    const Phase &P = phases.find(key)->second;
+    OS << key << " time: " << P.nanoseconds * 1e-9 << "\n";
+    OS << key << " peak memory: " << P.peakRSS / 1024 << " KB\n";
+  }
+  for (StringRef key : histogramOrder) {
+    const Histogram &H = histograms.find(key)->second;
+    OS << key << " time: " << H.getTotal() * 1e-9 << "\n";
+    OS << key << " count: " << H.getCount() << "\n";
+    OS << key << " p50: " << H.getPercentile(0.5) << " ns\n";
+    OS << key << " p99: " << H.getPercentile(0.99) << " ns\n";
+  }
+}
+
+void Profile::printPhasesJSON(raw_ostream &OS) const {
+  OS << "{\"phases\": [";
+  for (unsigned i = 0, e = phaseOrder.size(); i != e; ++i) {
+    const Phase &P = phases.find(phaseOrder[i])->second;
+    OS << (i ? ", " : "") << "{\"name\": \"" << phaseOrder[i]
+       << "\", \"ns\": " << P.nanoseconds << ", \"peak_rss\": " << P.peakRSS
+       << "}";
+  }
+  OS << "], \"latencies\": [";
+  for (unsigned i = 0, e = histogramOrder.size(); i != e; ++i) {
+    const Histogram &H = histograms.find(histogramOrder[i])->second;
+    OS << (i ? ", " : "") << "{\"name\": \"" << histogramOrder[i]
+       << "\", \"count\": " << H.getCount() << ", \"ns\": " << H.getTotal()
+       << ", \"p50_ns\": " << H.getPercentile(0.5)
+       << ", \"p99_ns\": " << H.getPercentile(0.99) << "}";
+  }
+  OS << "]}\n";
+}
+
 // Print name of variable according to its type
 static void printVarName(const Value *V, raw_ostream &OS) {
   const Argument *A = NULL;
@@ -267,14 +432,18 @@ template <class CGT> bool InterProceduralRA<CGT>::runOnModule(Module &M) {
 #ifdef STATS
   Profile::TimeValue before = prof.timenow();
 #endif
-  for (Module::iterator I = M.begin(), E = M.end(); I != E; ++I) {
-    // If the function is only a declaration, or if it has variable number of
-    // arguments, do not match
-    if (I->isDeclaration() || I->isVarArg())
-      continue;
+  if (RAThreads > 1) {
+    buildGraphParallel(M, RAThreads);
+  } else {
+    for (Module::iterator I = M.begin(), E = M.end(); I != E; ++I) {
+      // If the function is only a declaration, or if it has variable number
+      // of arguments, do not match
+      if (I->isDeclaration() || I->isVarArg())
+        continue;
 
-    CG->buildGraph(*I);
-    MatchParametersAndReturnValues(*I, *CG);
+      CG->buildGraph(*I);
+      MatchParametersAndReturnValues(*I, *CG);
+    }
   }
   CG->buildVarNodes();
 
@@ -304,6 +473,48 @@ void InterProceduralRA<CGT>::getAnalysisUsage(AnalysisUsage &AU) const {
   AU.setPreservesAll();
 }
 
+/// Builds the graph of each function on its own, in parallel, and merges
+/// them into CG. The matching of parameters and return values touches the
+/// nodes of callers and callees alike, so it runs afterwards, serially.
+template <class CGT>
+void InterProceduralRA<CGT>::buildGraphParallel(Module &M,
+                                                unsigned NumThreads) {
+  std::vector<Function *> Functions;
+  for (Module::iterator I = M.begin(), E = M.end(); I != E; ++I) {
+    if (I->isDeclaration() || I->isVarArg())
+      continue;
+
+    Functions.push_back(&*I);
+  }
+
+  // Threads take the next function without a graph until there are none
+  // left. Building a graph only reads the IR.
+  std::vector<CGT *> Subgraphs(Functions.size(), NULL);
+  std::atomic<unsigned> next(0);
+  auto worker = [&]() {
+    for (unsigned i = next++; i < Functions.size(); i = next++) {
+      Subgraphs[i] = new CGT();
+      Subgraphs[i]->buildGraph(*Functions[i]);
+    }
+  };
+  std::vector<std::thread> pool;
+  for (unsigned i = 1; i < NumThreads; ++i)
+    pool.push_back(std::thread(worker));
+  worker();
+  for (unsigned i = 0, e = pool.size(); i < e; ++i)
+    pool[i].join();
+
+  // Merge in module order, so that the result does not depend on which
+  // thread built which function.
+  for (unsigned i = 0, e = Subgraphs.size(); i < e; ++i) {
+    CG->absorb(*Subgraphs[i]);
+    delete Subgraphs[i];
+  }
+
+  for (unsigned i = 0, e = Functions.size(); i < e; ++i)
+    MatchParametersAndReturnValues(*Functions[i], *CG);
+}
+
 template <class CGT>
 void InterProceduralRA<CGT>::MatchParametersAndReturnValues(
     Function &F, ConstraintGraph &G) {
@@ -356,11 +567,13 @@ void InterProceduralRA<CGT>::MatchParametersAndReturnValues(
   // For each use of F, get the real parameters and the caller instruction to do
   // the matching
   std::vector<PhiOp *> matchers(F.arg_size(), NULL);
+  GraphArena &Arena = G.getArena();
 
   for (unsigned i = 0, e = Parameters.size(); i < e; ++i) {
     VarNode *sink = G.addVarNode(Parameters[i].first);
 
-    matchers[i] = new PhiOp(new BasicInterval(), sink, NULL, Instruction::PHI);
+    matchers[i] = Arena.create<PhiOp>(Arena.create<BasicInterval>(), sink,
+                                      nullptr, Instruction::PHI);
 
     // Insert the operation in the graph.
     G.getOprs()->insert(matchers[i]);
@@ -429,7 +642,8 @@ void InterProceduralRA<CGT>::MatchParametersAndReturnValues(
       // Add caller instruction to the CG (it receives the return value)
       to = G.addVarNode(caller);
 
-      PhiOp *phiOp = new PhiOp(new BasicInterval(), to, NULL, Instruction::PHI);
+      PhiOp *phiOp = Arena.create<PhiOp>(Arena.create<BasicInterval>(), to,
+                                         nullptr, Instruction::PHI);
 
       // Insert the operation in the graph.
       G.getOprs()->insert(phiOp);
@@ -493,22 +707,57 @@ static RegisterPass<InterProceduralRA<Cousot>>
 static RegisterPass<InterProceduralRA<CropDFS>>
     X("ra-inter-crop", "Range Analysis (Crop - inter)");
 
+// ========================================================================== //
+// InterProceduralRAAnalysis
+// ========================================================================== //
+template <class CGT> char InterProceduralRAAnalysis<CGT>::PassID;
+
+template <class CGT>
+typename InterProceduralRAAnalysis<CGT>::Result
+InterProceduralRAAnalysis<CGT>::run(Module &M) {
+  std::unique_ptr<InterProceduralRA<CGT>> RA(new InterProceduralRA<CGT>());
+  RA->runOnModule(M);
+  return Result(std::move(RA));
+}
+
+template class InterProceduralRAAnalysis<Cousot>;
+template class InterProceduralRAAnalysis<CropDFS>;
+
 // ========================================================================== //
 // Range
 // ========================================================================== //
-Range::Range() : l(Min), u(Max), type(Regular) {}
+Range::Range() : Range(Min, Max) {}
 
-Range::Range(APInt lb, APInt ub, RangeType rType) : l(lb), u(ub), type(rType) {
+Range::Range(APInt lb, APInt ub, RangeType rType)
+    : lo(0), hi(0), width(lb.getBitWidth()), type(rType) {
+  if (isNative()) {
+    lo = lb.getSExtValue();
+    hi = ub.getSExtValue();
+  } else {
+    l = lb;
+    u = ub;
+  }
   if (lb.sgt(ub))
     type = Empty;
 }
 
+Range::Range(unsigned Width, int64_t Lo, int64_t Hi)
+    : lo(Lo), hi(Hi), width(Width), type(Lo > Hi ? Empty : Regular) {}
+
 Range::~Range() {}
 
 bool Range::isMaxRange() const {
+  if (isNative())
+    return lo == getNativeMin() && hi == getNativeMax();
   return this->getLower().eq(Min) && this->getUpper().eq(Max);
 }
 
+// Both ranges keep native bounds of the same width
+static inline bool bothNative(const Range &a, const Range &b) {
+  return a.isNative() && b.isNative() &&
+         a.getNativeMin() == b.getNativeMin();
+}
+
 /// Add and Mul are commutative. So, they are a little different
 /// than the other operations.
 Range Range::add(const Range &other) const {
@@ -516,6 +765,22 @@ Range Range::add(const Range &other) const {
     return Range(Min, Max, Unknown);
   }
 
+  if (bothNative(*this, other)) {
+    int64_t a = lo, b = hi, c = other.lo, d = other.hi;
+    int64_t min = getNativeMin(), max = getNativeMax();
+    int64_t l = min, u = max;
+    // An overflow is a sum out of [Min, Max]
+    if (a != min && c != min) {
+      __int128 s = (__int128)a + c;
+      l = (s < min || s > max) ? min : (int64_t)s;
+    }
+    if (b != max && d != max) {
+      __int128 s = (__int128)b + d;
+      u = (s < min || s > max) ? max : (int64_t)s;
+    }
+    return Range(width, l, u);
+  }
+
   const APInt &a = this->getLower();
   const APInt &b = this->getUpper();
   const APInt &c = other.getLower();
@@ -549,6 +814,21 @@ Range Range::sub(const Range &other) const {
     return Range(Min, Max, Unknown);
   }
 
+  if (bothNative(*this, other)) {
+    int64_t a = lo, b = hi, c = other.lo, d = other.hi;
+    int64_t min = getNativeMin(), max = getNativeMax();
+    int64_t l = min, u = max;
+    if (a != min && d != max) {
+      __int128 s = (__int128)a - d;
+      l = (s < min || s > max) ? min : (int64_t)s;
+    }
+    if (b != max && c != min) {
+      __int128 s = (__int128)b - c;
+      u = (s < min || s > max) ? max : (int64_t)s;
+    }
+    return Range(width, l, u);
+  }
+
   const APInt &a = this->getLower();
   const APInt &b = this->getUpper();
   const APInt &c = other.getLower();
@@ -611,6 +891,22 @@ Range Range::mul(const Range &other) const {
     return Range(Min, Max);
   }
 
+  if (bothNative(*this, other)) {
+    int64_t a = lo, b = hi, c = other.lo, d = other.hi;
+    int64_t min = getNativeMin(), max = getNativeMax();
+    int64_t candidates[4];
+    candidates[0] = mulOverflow(a, c, mulHelper(a, c, min, max, width),
+                                min, max);
+    candidates[1] = mulOverflow(a, d, mulHelper(a, d, min, max, width),
+                                min, max);
+    candidates[2] = mulOverflow(b, c, mulHelper(b, c, min, max, width),
+                                min, max);
+    candidates[3] = mulOverflow(b, d, mulHelper(b, d, min, max, width),
+                                min, max);
+    return Range(width, *std::min_element(candidates, candidates + 4),
+                 *std::max_element(candidates, candidates + 4));
+  }
+
   const APInt &a = this->getLower();
   const APInt &b = this->getUpper();
   const APInt &c = other.getLower();
@@ -1170,6 +1466,9 @@ Range Range::intersectWith(const Range &other) const {
     return *this;
   }
 
+  if (bothNative(*this, other))
+    return Range(width, std::max(lo, other.lo), std::min(hi, other.hi));
+
   APInt l = getLower().sgt(other.getLower()) ? getLower() : other.getLower();
   APInt u = getUpper().slt(other.getUpper()) ? getUpper() : other.getUpper();
   return Range(l, u);
@@ -1192,17 +1491,24 @@ Range Range::unionWith(const Range &other) const {
     return *this;
   }
 
+  if (bothNative(*this, other))
+    return Range(width, std::min(lo, other.lo), std::max(hi, other.hi));
+
   APInt l = getLower().slt(other.getLower()) ? getLower() : other.getLower();
   APInt u = getUpper().sgt(other.getUpper()) ? getUpper() : other.getUpper();
   return Range(l, u);
 }
 
 bool Range::operator==(const Range &other) const {
+  if (bothNative(*this, other))
+    return type == other.type && lo == other.lo && hi == other.hi;
   return this->type == other.type && getLower().eq(other.getLower()) &&
          getUpper().eq(other.getUpper());
 }
 
 bool Range::operator!=(const Range &other) const {
+  if (bothNative(*this, other))
+    return type != other.type || lo != other.lo || hi != other.hi;
   return this->type != other.type || getLower().ne(other.getLower()) ||
          getUpper().ne(other.getUpper());
 }
@@ -1410,8 +1716,16 @@ BasicOp::BasicOp(BasicInterval *intersect, VarNode *sink,
     : intersect(intersect), sink(sink), inst(inst) {}
 
 /// We can not want people creating objects of this class,
-/// but we want to inherit of it.
-BasicOp::~BasicOp() { delete intersect; }
+/// but we want to inherit of it. The intersect belongs to the arena of the
+/// graph, and may be shared with the branch and switch maps.
+BasicOp::~BasicOp() {}
+
+/// Replaces the nodes of the operation that appear as keys in Map.
+void BasicOp::remapVarNodes(const DenseMap<const VarNode *, VarNode *> &Map) {
+  DenseMap<const VarNode *, VarNode *>::const_iterator it = Map.find(sink);
+  if (it != Map.end())
+    sink = it->second;
+}
 
 /// Replace symbolic intervals with hard-wired constants.
 void BasicOp::fixIntersects(VarNode *V) {
@@ -1428,7 +1742,8 @@ void BasicOp::fixIntersects(VarNode *V) {
 ControlDep::ControlDep(VarNode *sink, VarNode *source)
     : BasicOp(new BasicInterval(), sink, NULL), source(source) {}
 
-ControlDep::~ControlDep() {}
+// Control dependences are temporary and live outside the arena of the graph.
+ControlDep::~ControlDep() { delete getIntersect(); }
 
 Range ControlDep::eval() const { return Range(Min, Max); }
 
@@ -1445,6 +1760,13 @@ UnaryOp::UnaryOp(BasicInterval *intersect, VarNode *sink,
 // The dtor.
 UnaryOp::~UnaryOp() {}
 
+void UnaryOp::remapVarNodes(const DenseMap<const VarNode *, VarNode *> &Map) {
+  BasicOp::remapVarNodes(Map);
+  DenseMap<const VarNode *, VarNode *>::const_iterator it = Map.find(source);
+  if (it != Map.end())
+    source = it->second;
+}
+
 /// Computes the interval of the sink based on the interval of the sources,
 /// the operation and the interval associated to the operation.
 Range UnaryOp::eval() const {
@@ -1580,6 +1902,16 @@ BinaryOp::BinaryOp(BasicInterval *intersect, VarNode *sink,
 /// The dtor.
 BinaryOp::~BinaryOp() {}
 
+void BinaryOp::remapVarNodes(const DenseMap<const VarNode *, VarNode *> &Map) {
+  BasicOp::remapVarNodes(Map);
+  DenseMap<const VarNode *, VarNode *>::const_iterator it = Map.find(source1);
+  if (it != Map.end())
+    source1 = it->second;
+  it = Map.find(source2);
+  if (it != Map.end())
+    source2 = it->second;
+}
+
 /// Computes the interval of the sink based on the interval of the sources,
 /// the operation and the interval associated to the operation.
 /// Basically, this function performs the operation indicated in its opcode
@@ -1711,6 +2043,16 @@ void PhiOp::addSource(const VarNode *newsrc) {
   this->sources.push_back(newsrc);
 }
 
+void PhiOp::remapVarNodes(const DenseMap<const VarNode *, VarNode *> &Map) {
+  BasicOp::remapVarNodes(Map);
+  for (unsigned i = 0, e = sources.size(); i < e; ++i) {
+    DenseMap<const VarNode *, VarNode *>::const_iterator it =
+        Map.find(sources[i]);
+    if (it != Map.end())
+      sources[i] = it->second;
+  }
+}
+
 /// Computes the interval of the sink based on the interval of the sources.
 /// The result of evaluating a phi-function is the union of the ranges of
 /// every variable used in the phi.
@@ -1767,18 +2109,6 @@ ValueBranchMap::ValueBranchMap(const Value *V, const BasicBlock *BBTrue,
 
 ValueBranchMap::~ValueBranchMap() {}
 
-void ValueBranchMap::clear() {
-  if (ItvT) {
-    delete ItvT;
-    ItvT = NULL;
-  }
-
-  if (ItvF) {
-    delete ItvF;
-    ItvF = NULL;
-  }
-}
-
 // ========================================================================== //
 // ValueSwitchMap
 // ========================================================================== //
@@ -1790,44 +2120,20 @@ ValueSwitchMap::ValueSwitchMap(
 
 ValueSwitchMap::~ValueSwitchMap() {}
 
-void ValueSwitchMap::clear() {
-  for (unsigned i = 0, e = BBsuccs.size(); i < e; ++i) {
-    if (BBsuccs[i].first) {
-      delete BBsuccs[i].first;
-      BBsuccs[i].first = NULL;
-    }
-  }
-}
-
 // ========================================================================== //
 // ConstraintGraph
 // ========================================================================== //
 
-ConstraintGraph::ConstraintGraph() { this->func = NULL; }
+ConstraintGraph::ConstraintGraph() {
+  this->func = NULL;
+  this->arenas.push_back(new GraphArena());
+}
 
 /// The dtor.
+/// The nodes, operations and intervals go away with the arenas.
 ConstraintGraph::~ConstraintGraph() {
-
-  for (VarNodes::iterator vit = vars.begin(), vend = vars.end(); vit != vend;
-       ++vit) {
-    delete vit->second;
-  }
-
-  for (GenOprs::iterator oit = oprs.begin(), oend = oprs.end(); oit != oend;
-       ++oit) {
-    delete *oit;
-  }
-
-  for (ValuesBranchMap::iterator vit = valuesBranchMap.begin(),
-                                 vend = valuesBranchMap.end();
-       vit != vend; ++vit) {
-    vit->second.clear();
-  }
-
-  for (ValuesSwitchMap::iterator vit = valuesSwitchMap.begin(),
-                                 vend = valuesSwitchMap.end();
-       vit != vend; ++vit) {
-    vit->second.clear();
+  for (unsigned i = 0, e = arenas.size(); i < e; ++i) {
+    delete arenas[i];
   }
 }
 
@@ -1868,7 +2174,7 @@ VarNode *ConstraintGraph::addVarNode(const Value *V) {
     return vit->second;
   }
 
-  VarNode *node = new VarNode(V);
+  VarNode *node = getArena().create<VarNode>(V);
   this->vars.insert(std::make_pair(V, node));
 
   // Inserts the node in the use map list.
@@ -1879,6 +2185,7 @@ VarNode *ConstraintGraph::addVarNode(const Value *V) {
 
 /// Adds an UnaryOp in the graph.
 void ConstraintGraph::addUnaryOp(const Instruction *I) {
+  GraphArena &Arena = getArena();
   // Create the sink.
   VarNode *sink = addVarNode(I);
   // Create the source.
@@ -1901,7 +2208,8 @@ void ConstraintGraph::addUnaryOp(const Instruction *I) {
 
 #ifndef OVERFLOWHANDLER
   // Create the operation using the intersect to constrain sink's interval.
-  UOp = new UnaryOp(new BasicInterval(), sink, I, source, I->getOpcode());
+  UOp = Arena.create<UnaryOp>(Arena.create<BasicInterval>(), sink, I, source,
+                              I->getOpcode());
 #else
   // I can only be an Add instruction if it is a newdef overflow instruction
   if (I->getOpcode() == Instruction::Add) {
@@ -1926,8 +2234,8 @@ void ConstraintGraph::addUnaryOp(const Instruction *I) {
         lower -= constant;
       }
 
-      UOp = new UnaryOp(new BasicInterval(lower, upper), sink, I, source,
-                        I->getOpcode());
+      UOp = Arena.create<UnaryOp>(Arena.create<BasicInterval>(lower, upper),
+                                  sink, I, source, I->getOpcode());
       break;
 
     case Instruction::Sub:
@@ -1942,8 +2250,8 @@ void ConstraintGraph::addUnaryOp(const Instruction *I) {
         upper += constant;
       }
 
-      UOp = new UnaryOp(new BasicInterval(lower, upper), sink, I, source,
-                        I->getOpcode());
+      UOp = Arena.create<UnaryOp>(Arena.create<BasicInterval>(lower, upper),
+                                  sink, I, source, I->getOpcode());
       break;
 
     case Instruction::Mul:
@@ -1963,8 +2271,9 @@ void ConstraintGraph::addUnaryOp(const Instruction *I) {
         candidates[1] = swap;
       }
 
-      UOp = new UnaryOp(new BasicInterval(candidates[0], candidates[1]), sink,
-                        I, source, I->getOpcode());
+      UOp = Arena.create<UnaryOp>(
+          Arena.create<BasicInterval>(candidates[0], candidates[1]), sink, I,
+          source, I->getOpcode());
       break;
 
     case Instruction::Trunc:
@@ -1983,13 +2292,14 @@ void ConstraintGraph::addUnaryOp(const Instruction *I) {
 
       Range truncInterval(minvalue, maxvalue, Regular);
 
-      UOp = new UnaryOp(new BasicInterval(truncInterval), sink, I, source,
-                        I->getOpcode());
+      UOp = Arena.create<UnaryOp>(Arena.create<BasicInterval>(truncInterval),
+                                  sink, I, source, I->getOpcode());
       break;
     }
   } else {
     // Create the operation using the intersect to constrain sink's interval.
-    UOp = new UnaryOp(new BasicInterval(), sink, I, source, I->getOpcode());
+    UOp = Arena.create<UnaryOp>(Arena.create<BasicInterval>(), sink, I, source,
+                                I->getOpcode());
   }
 #endif
 
@@ -2015,8 +2325,9 @@ void ConstraintGraph::addBinaryOp(const Instruction *I) {
   VarNode *source2 = addVarNode(I->getOperand(1));
 
   // Create the operation using the intersect to constrain sink's interval.
-  BasicInterval *BI = new BasicInterval();
-  BinaryOp *BOp = new BinaryOp(BI, sink, I, source1, source2, I->getOpcode());
+  BasicInterval *BI = getArena().create<BasicInterval>();
+  BinaryOp *BOp = getArena().create<BinaryOp>(BI, sink, I, source1, source2,
+                                              I->getOpcode());
 
   // Insert the operation in the graph.
   this->oprs.insert(BOp);
@@ -2033,7 +2344,8 @@ void ConstraintGraph::addBinaryOp(const Instruction *I) {
 void ConstraintGraph::addPhiOp(const PHINode *Phi) {
   // Create the sink.
   VarNode *sink = addVarNode(Phi);
-  PhiOp *phiOp = new PhiOp(new BasicInterval(), sink, Phi, Phi->getOpcode());
+  PhiOp *phiOp = getArena().create<PhiOp>(getArena().create<BasicInterval>(),
+                                          sink, Phi, Phi->getOpcode());
 
   // Insert the operation in the graph.
   this->oprs.insert(phiOp);
@@ -2102,10 +2414,12 @@ void ConstraintGraph::addSigmaOp(const PHINode *Sigma) {
     }
 
     if (BItv == NULL) {
-      sigmaOp = new SigmaOp(new BasicInterval(), sink, Sigma, source,
-                            Sigma->getOpcode());
+      sigmaOp = getArena().create<SigmaOp>(getArena().create<BasicInterval>(),
+                                           sink, Sigma, source,
+                                           Sigma->getOpcode());
     } else {
-      sigmaOp = new SigmaOp(BItv, sink, Sigma, source, Sigma->getOpcode());
+      sigmaOp = getArena().create<SigmaOp>(BItv, sink, Sigma, source,
+                                           Sigma->getOpcode());
     }
 
     // Insert the operation in the graph.
@@ -2195,7 +2509,7 @@ void ConstraintGraph::buildValueSwitchMap(const SwitchInst *sw) {
     Range Values = Range(sigMin, sigMax);
 
     // Create the interval using the intersection in the branch.
-    BasicInterval *BI = new BasicInterval(Values);
+    BasicInterval *BI = getArena().create<BasicInterval>(Values);
 
     BBsuccs.push_back(std::make_pair(BI, succ));
   }
@@ -2225,7 +2539,7 @@ void ConstraintGraph::buildValueSwitchMap(const SwitchInst *sw) {
     Range Values = Range(sigMin, sigMax);
 
     // Create the interval using the intersection in the branch.
-    BasicInterval *BI = new BasicInterval(Values);
+    BasicInterval *BI = getArena().create<BasicInterval>(Values);
 
     BBsuccs.push_back(std::make_pair(BI, succ));
   }
@@ -2336,8 +2650,8 @@ void ConstraintGraph::buildValueBranchMap(const BranchInst *br) {
     Range FValues = Range(sigMin, sigMax);
 
     // Create the interval using the intersection in the branch.
-    BasicInterval *BT = new BasicInterval(TValues);
-    BasicInterval *BF = new BasicInterval(FValues);
+    BasicInterval *BT = getArena().create<BasicInterval>(TValues);
+    BasicInterval *BF = getArena().create<BasicInterval>(FValues);
 
     ValueBranchMap VBM(variable, TBlock, FBlock, BT, BF);
     valuesBranchMap.insert(std::make_pair(variable, VBM));
@@ -2348,8 +2662,8 @@ void ConstraintGraph::buildValueBranchMap(const BranchInst *br) {
     if ((castinst = dyn_cast<CastInst>(variable))) {
       const Value *variable_0 = castinst->getOperand(0);
 
-      BasicInterval *BT = new BasicInterval(TValues);
-      BasicInterval *BF = new BasicInterval(FValues);
+      BasicInterval *BT = getArena().create<BasicInterval>(TValues);
+      BasicInterval *BF = getArena().create<BasicInterval>(FValues);
 
       ValueBranchMap VBM(variable_0, TBlock, FBlock, BT, BF);
       valuesBranchMap.insert(std::make_pair(variable_0, VBM));
@@ -2364,8 +2678,8 @@ void ConstraintGraph::buildValueBranchMap(const BranchInst *br) {
     Range CR(Min, Max, Unknown);
 
     // Symbolic intervals for op0
-    SymbInterval *STOp0 = new SymbInterval(CR, Op1, pred);
-    SymbInterval *SFOp0 = new SymbInterval(CR, Op1, invPred);
+    SymbInterval *STOp0 = getArena().create<SymbInterval>(CR, Op1, pred);
+    SymbInterval *SFOp0 = getArena().create<SymbInterval>(CR, Op1, invPred);
 
     ValueBranchMap VBMOp0(Op0, TBlock, FBlock, STOp0, SFOp0);
     valuesBranchMap.insert(std::make_pair(Op0, VBMOp0));
@@ -2375,16 +2689,16 @@ void ConstraintGraph::buildValueBranchMap(const BranchInst *br) {
     if ((castinst = dyn_cast<CastInst>(Op0))) {
       const Value *Op0_0 = castinst->getOperand(0);
 
-      SymbInterval *STOp1_1 = new SymbInterval(CR, Op1, pred);
-      SymbInterval *SFOp1_1 = new SymbInterval(CR, Op1, invPred);
+      SymbInterval *STOp1_1 = getArena().create<SymbInterval>(CR, Op1, pred);
+      SymbInterval *SFOp1_1 = getArena().create<SymbInterval>(CR, Op1, invPred);
 
       ValueBranchMap VBMOp1_1(Op0_0, TBlock, FBlock, STOp1_1, SFOp1_1);
       valuesBranchMap.insert(std::make_pair(Op0_0, VBMOp1_1));
     }
 
     // Symbolic intervals for op1
-    SymbInterval *STOp1 = new SymbInterval(CR, Op0, invPred);
-    SymbInterval *SFOp1 = new SymbInterval(CR, Op0, pred);
+    SymbInterval *STOp1 = getArena().create<SymbInterval>(CR, Op0, invPred);
+    SymbInterval *SFOp1 = getArena().create<SymbInterval>(CR, Op0, pred);
     ValueBranchMap VBMOp1(Op1, TBlock, FBlock, STOp1, SFOp1);
     valuesBranchMap.insert(std::make_pair(Op1, VBMOp1));
 
@@ -2393,8 +2707,8 @@ void ConstraintGraph::buildValueBranchMap(const BranchInst *br) {
     if ((castinst = dyn_cast<CastInst>(Op1))) {
       const Value *Op0_0 = castinst->getOperand(0);
 
-      SymbInterval *STOp1_1 = new SymbInterval(CR, Op1, pred);
-      SymbInterval *SFOp1_1 = new SymbInterval(CR, Op1, invPred);
+      SymbInterval *STOp1_1 = getArena().create<SymbInterval>(CR, Op1, pred);
+      SymbInterval *SFOp1_1 = getArena().create<SymbInterval>(CR, Op1, invPred);
 
       ValueBranchMap VBMOp1_1(Op0_0, TBlock, FBlock, STOp1_1, SFOp1_1);
       valuesBranchMap.insert(std::make_pair(Op0_0, VBMOp1_1));
@@ -2615,6 +2929,73 @@ void ConstraintGraph::buildGraph(const Function &F) {
   }
 }
 
+/// Moves the nodes and operations of G into this graph. Values that already
+/// have a node here, such as constants used by several functions, keep it,
+/// and the operations of G are redirected to it.
+void ConstraintGraph::absorb(ConstraintGraph &G) {
+  DenseMap<const VarNode *, VarNode *> Remap;
+
+  for (VarNodes::iterator vit = G.vars.begin(), vend = G.vars.end();
+       vit != vend; ++vit) {
+    VarNodes::iterator old = this->vars.find(vit->first);
+
+    if (old != this->vars.end()) {
+      Remap[vit->second] = old->second;
+      continue;
+    }
+
+    this->vars.insert(*vit);
+  }
+
+  for (GenOprs::iterator oit = G.oprs.begin(), oend = G.oprs.end();
+       oit != oend; ++oit) {
+    if (!Remap.empty()) {
+      (*oit)->remapVarNodes(Remap);
+    }
+
+    this->oprs.insert(*oit);
+  }
+
+  for (DefMap::iterator dit = G.defMap.begin(), dend = G.defMap.end();
+       dit != dend; ++dit) {
+    this->defMap[dit->first] = dit->second;
+  }
+
+  for (UseMap::iterator uit = G.useMap.begin(), uend = G.useMap.end();
+       uit != uend; ++uit) {
+    this->useMap[uit->first].insert(uit->second.begin(), uit->second.end());
+  }
+
+  // The intervals of these maps are shared with the sigmas of G, and live in
+  // its arena. If a value is already mapped here, the entry of G is dropped,
+  // just as buildValueMaps does when it meets a value twice.
+  for (ValuesBranchMap::iterator vit = G.valuesBranchMap.begin(),
+                                 vend = G.valuesBranchMap.end();
+       vit != vend; ++vit) {
+    this->valuesBranchMap.insert(*vit);
+  }
+
+  for (ValuesSwitchMap::iterator vit = G.valuesSwitchMap.begin(),
+                                 vend = G.valuesSwitchMap.end();
+       vit != vend; ++vit) {
+    this->valuesSwitchMap.insert(*vit);
+  }
+
+  // The nodes replaced above stay in the arenas of G, which are taken over.
+  this->arenas.append(G.arenas.begin(), G.arenas.end());
+  G.arenas.clear();
+  G.arenas.push_back(new GraphArena());
+
+  this->func = G.func;
+
+  G.vars.clear();
+  G.oprs.clear();
+  G.defMap.clear();
+  G.useMap.clear();
+  G.valuesBranchMap.clear();
+  G.valuesSwitchMap.clear();
+}
+
 void ConstraintGraph::buildVarNodes() {
   // Initializes the nodes and the use map structure.
   VarNodes::iterator bgn = this->vars.begin(), end = this->vars.end();
@@ -3453,6 +3834,7 @@ void Nuutila::delControlDependenceEdges(UseMap *useMap) {
 
       // Remove pseudo edge from the map
       it->second.erase(op);
+      delete op;
     }
   }
 }
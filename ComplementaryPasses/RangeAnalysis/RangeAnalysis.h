@@ -44,9 +44,11 @@
 #include "llvm/IR/Module.h"
 #include "llvm/IR/ConstantRange.h"
 #include "llvm/IR/InstIterator.h"
+#include "llvm/IR/PassManager.h"
 #include "llvm/ADT/DenseMap.h"
 #include "llvm/IR/CallSite.h"
 #include "llvm/ADT/StringMap.h"
+#include "llvm/Support/Allocator.h"
 #include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/ADT/Statistic.h"
 #include "llvm/Support/Debug.h"
@@ -54,11 +56,16 @@
 #include "llvm/Support/TimeValue.h"
 #include "llvm/Support/Process.h"
 #include "llvm/Support/FileSystem.h"
+#include "llvm/Support/CommandLine.h"
 #include <deque>
 #include <stack>
 #include <set>
 #include <sstream>
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
 
 using namespace llvm;
 
@@ -77,6 +84,11 @@ using namespace llvm;
 // running time, so I recommend leaving it activated
 #define JUMPSET
 
+// Comment the line below to always store ranges as APInt. Otherwise, ranges
+// at most 64 bits wide keep their bounds as native integers, and add, sub,
+// mul, intersectWith and unionWith compute on them.
+#define RANGE_FASTPATH
+
 //#define OVERFLOWHANDLER
 
 // Used to limit the number of iterations of fixed meet operator.
@@ -157,16 +169,47 @@ class Range {
 private:
   APInt l; // The lower bound of the range.
   APInt u; // The upper bound of the range.
+  // The bounds of native ranges, which leave l and u empty
+  int64_t lo, hi;
+  unsigned width;
   RangeType type;
 
+  Range(unsigned Width, int64_t Lo, int64_t Hi);
+
 public:
   Range();
   Range(APInt lb, APInt ub, RangeType type = Regular);
   ~Range();
-  APInt getLower() const { return l; }
-  APInt getUpper() const { return u; }
-  void setLower(const APInt &newl) { this->l = newl; }
-  void setUpper(const APInt &newu) { this->u = newu; }
+  APInt getLower() const { return isNative() ? APInt(width, lo, true) : l; }
+  APInt getUpper() const { return isNative() ? APInt(width, hi, true) : u; }
+  void setLower(const APInt &newl) {
+    if (isNative())
+      lo = newl.getSExtValue();
+    else
+      l = newl;
+  }
+  void setUpper(const APInt &newu) {
+    if (isNative())
+      hi = newu.getSExtValue();
+    else
+      u = newu;
+  }
+  /// Tells if the bounds are kept as native integers. The limits of the
+  /// width, which the APInt code reads from Min and Max, come from the range
+  /// itself.
+  bool isNative() const {
+#ifdef RANGE_FASTPATH
+    return width <= 64;
+#else
+    return false;
+#endif
+  }
+  int64_t getNativeLower() const { return lo; }
+  int64_t getNativeUpper() const { return hi; }
+  int64_t getNativeMin() const {
+    return width == 64 ? INT64_MIN : -((int64_t)1 << (width - 1));
+  }
+  int64_t getNativeMax() const { return ~getNativeMin(); }
   bool isUnknown() const { return type == Unknown; }
   void setUnknown() { type = Unknown; }
   bool isRegular() const { return type == Regular; }
@@ -349,6 +392,8 @@ public:
   /// Returns the target of the operation, that is,
   /// where the result will be stored.
   VarNode *getSink() { return sink; }
+  /// Replaces the nodes of the operation that appear as keys in Map.
+  virtual void remapVarNodes(const DenseMap<const VarNode *, VarNode *> &Map);
   /// Prints the content of the operation.
   virtual void print(raw_ostream &OS) const = 0;
 };
@@ -380,6 +425,7 @@ public:
   unsigned int getOpcode() const { return opcode; }
   /// Returns the source of the operation.
   VarNode *getSource() const { return source; }
+  void remapVarNodes(const DenseMap<const VarNode *, VarNode *> &Map);
   /// Prints the content of the operation. I didn't it an operator overload
   /// because I had problems to access the members of the class outside it.
   void print(raw_ostream &OS) const;
@@ -457,6 +503,7 @@ public:
   // Return source identified by index
   const VarNode *getSource(unsigned index) const { return sources[index]; }
   unsigned getNumSources() const { return sources.size(); }
+  void remapVarNodes(const DenseMap<const VarNode *, VarNode *> &Map);
   // Methods for RTTI
   virtual OperationId getValueId() const { return PhiOpId; }
   static bool classof(PhiOp const *) { return true; }
@@ -495,6 +542,7 @@ public:
   VarNode *getSource1() const { return source1; }
   /// Returns the second operand of this operation.
   VarNode *getSource2() const { return source2; }
+  void remapVarNodes(const DenseMap<const VarNode *, VarNode *> &Map);
   /// Prints the content of the operation. I didn't it an operator overload
   /// because I had problems to access the members of the class outside it.
   void print(raw_ostream &OS) const;
@@ -531,8 +579,6 @@ public:
   void setItvT(BasicInterval *Itv) { this->ItvT = Itv; }
   /// Change the interval associated to the false side of the branch
   void setItvF(BasicInterval *Itv) { this->ItvF = Itv; }
-  /// Clear memory allocated
-  void clear();
 };
 
 /// This is pretty much the same thing as ValueBranchMap
@@ -561,8 +607,6 @@ public:
   void setItv(unsigned idx, BasicInterval *Itv) {
     this->BBsuccs[idx].first = Itv;
   }
-  /// Clear memory allocated
-  void clear();
 };
 
 /// This class can be used to gather statistics on running time
@@ -628,13 +672,69 @@ public:
   // Map to store accumulated times
   typedef StringMap<TimeValue> AccTimesMap;
 
+  // Wall time of a phase, and the peak memory of the process when it ended
+  struct Phase {
+    uint64_t nanoseconds;
+    size_t peakRSS;
+    Phase() : nanoseconds(0), peakRSS(0) {}
+  };
+
+  // Latencies in power of two buckets of nanoseconds: bucket b holds the
+  // latencies below 2^(b+1), so percentiles are within a factor of two.
+  class Histogram {
+    uint64_t buckets[64];
+    uint64_t count, total;
+
+  public:
+    Histogram() { reset(); }
+    void reset();
+    void add(uint64_t nanoseconds);
+    // Adds the samples of Other
+    void merge(const Histogram &Other);
+    uint64_t getCount() const { return count; }
+    uint64_t getTotal() const { return total; }
+    // Upper bound of the latency of the given fraction of the samples
+    uint64_t getPercentile(double p) const;
+  };
+
 private:
   AccTimesMap accumulatedtimes;
   size_t memory;
+  // Phases and histograms, listed in the order they were first used. The
+  // references to them stay valid.
+  StringMap<Phase> phases;
+  std::vector<StringRef> phaseOrder;
+  StringMap<Histogram> histograms;
+  std::vector<StringRef> histogramOrder;
 
 public:
   Profile() : memory(0) {}
 
+  // Monotonic wall clock, in nanoseconds
+  static uint64_t ticks() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+  }
+  // Peak resident set size of the process so far, in bytes
+  static size_t getPeakRSS();
+
+  Phase &getPhase(StringRef key);
+  // Adds to the time of the phase and takes its peak memory
+  void updatePhase(StringRef key, uint64_t nanoseconds);
+  Histogram &getHistogram(StringRef key);
+  // Zeroes the phases and histograms, keeping the references valid
+  void resetPhases();
+  // Adds the phases and histograms of Other to these ones; peak memory is
+  // the highest of both
+  void addPhases(const Profile &Other);
+  // Wall time of every phase and histogram
+  uint64_t getTotalNanoseconds() const;
+  // One line per datum, "<name> time: <seconds>" first
+  void printPhases(raw_ostream &OS) const;
+  // A single line of JSON
+  void printPhasesJSON(raw_ostream &OS) const;
+
   TimeValue timenow() {
     TimeValue garbage, usertime;
     sys::Process::GetTimeUsage(garbage, usertime, garbage);
@@ -699,6 +799,37 @@ typedef DenseMap<const Value *, ValueBranchMap> ValuesBranchMap;
 
 typedef DenseMap<const Value *, ValueSwitchMap> ValuesSwitchMap;
 
+/// The storage of the nodes, operations and intervals of a constraint graph.
+/// Objects are created with create<T>(ctor args) and are all freed together
+/// with the arena, never one by one.
+class GraphArena {
+private:
+  SpecificBumpPtrAllocator<VarNode> VarNodes;
+  SpecificBumpPtrAllocator<UnaryOp> UnaryOps;
+  SpecificBumpPtrAllocator<SigmaOp> SigmaOps;
+  SpecificBumpPtrAllocator<BinaryOp> BinaryOps;
+  SpecificBumpPtrAllocator<PhiOp> PhiOps;
+  SpecificBumpPtrAllocator<BasicInterval> BasicIntervals;
+  SpecificBumpPtrAllocator<SymbInterval> SymbIntervals;
+
+  SpecificBumpPtrAllocator<VarNode> &get(VarNode *) { return VarNodes; }
+  SpecificBumpPtrAllocator<UnaryOp> &get(UnaryOp *) { return UnaryOps; }
+  SpecificBumpPtrAllocator<SigmaOp> &get(SigmaOp *) { return SigmaOps; }
+  SpecificBumpPtrAllocator<BinaryOp> &get(BinaryOp *) { return BinaryOps; }
+  SpecificBumpPtrAllocator<PhiOp> &get(PhiOp *) { return PhiOps; }
+  SpecificBumpPtrAllocator<BasicInterval> &get(BasicInterval *) {
+    return BasicIntervals;
+  }
+  SpecificBumpPtrAllocator<SymbInterval> &get(SymbInterval *) {
+    return SymbIntervals;
+  }
+
+public:
+  template <class T, class... ArgTs> T *create(ArgTs &&... Args) {
+    return new (get((T *)nullptr).Allocate()) T(std::forward<ArgTs>(Args)...);
+  }
+};
+
 /// This class represents our constraint graph. This graph is used to
 /// perform all computations in our analysis.
 class ConstraintGraph {
@@ -709,6 +840,9 @@ protected:
   GenOprs oprs;
 
 private:
+  // Owns the nodes, operations and intervals of the graph. The arenas of the
+  // graphs merged into this one by absorb are kept after the first.
+  SmallVector<GraphArena *, 1> arenas;
   // Save the last Function analyzed
   const Function *func;
   // A map from variables to the operations that define them
@@ -776,6 +910,7 @@ public:
   /// Adds a VarNode in the graph.
   VarNode *addVarNode(const Value *V);
 
+  GraphArena &getArena() { return *arenas.front(); }
   GenOprs *getOprs() { return &oprs; }
   DefMap *getDefMap() { return &defMap; }
   UseMap *getUseMap() { return &useMap; }
@@ -783,6 +918,9 @@ public:
   void addUnaryOp(const Instruction *I);
   /// Iterates through all instructions in the function and builds the graph.
   void buildGraph(const Function &F);
+  /// Moves the nodes and operations of G, usually the graph of a single
+  /// function, into this graph. G is left empty.
+  void absorb(ConstraintGraph &G);
   void buildVarNodes();
   void buildSymbolicIntersectMap();
   UseMap buildUseMap(const SmallPtrSet<VarNode *, 32> &component);
@@ -901,7 +1039,7 @@ public:
 };
 
 template <class CGT>
-class InterProceduralRA : public ModulePass, RangeAnalysis {
+class InterProceduralRA : public ModulePass, public RangeAnalysis {
 public:
   static char ID; // Pass identification, replacement for typeid
   InterProceduralRA() : ModulePass(ID) { CG = NULL; }
@@ -916,10 +1054,11 @@ public:
 
 private:
   void MatchParametersAndReturnValues(Function &F, ConstraintGraph &G);
+  void buildGraphParallel(Module &M, unsigned NumThreads);
 };
 
 template <class CGT>
-class IntraProceduralRA : public FunctionPass, RangeAnalysis {
+class IntraProceduralRA : public FunctionPass, public RangeAnalysis {
 public:
   static char ID; // Pass identification, replacement for typeid
   IntraProceduralRA() : FunctionPass(ID) {
@@ -934,4 +1073,32 @@ public:
   virtual Range getRange(const Value *v);
 }; // end of class RangeAnalysis
 
+/// InterProceduralRA as an analysis of the new pass manager. The result owns
+/// a pass object, run outside of the legacy pass manager, and the analysis
+/// manager keeps it across passes until a pass does not preserve it.
+template <class CGT> class InterProceduralRAAnalysis {
+public:
+  class Result {
+    std::unique_ptr<InterProceduralRA<CGT>> RA;
+
+  public:
+    explicit Result(std::unique_ptr<InterProceduralRA<CGT>> RA)
+        : RA(std::move(RA)) {}
+    Result(Result &&Other) : RA(std::move(Other.RA)) {}
+
+    Range getRange(const Value *v) { return RA->getRange(v); }
+    InterProceduralRA<CGT> &getAnalysis() { return *RA; }
+    bool invalidate(Module &M, const PreservedAnalyses &PA) {
+      return !PA.preserved(ID());
+    }
+  };
+
+  static void *ID() { return (void *)&PassID; }
+  static StringRef name() { return "InterProceduralRAAnalysis"; }
+  Result run(Module &M);
+
+private:
+  static char PassID;
+};
+
 #endif /* LLVM_TRANSFORMS_RANGEANALYSIS_RANGEANALYSIS_H_ */
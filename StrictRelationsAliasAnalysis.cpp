@@ -1,12 +1,15 @@
 #define DEBUG_TYPE "sraa"
 #include "StrictRelationsAliasAnalysis.h"
 
+#include <algorithm>
+#include <atomic>
 #include <utility>
-#include <ctime>
 #include <set>
 #include <queue>
+#include <thread>
 
 #include "llvm/Pass.h"
+#include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/Statistic.h"
 #include "llvm/IR/Argument.h"
 #include "llvm/IR/Constants.h"
@@ -16,24 +19,36 @@
 #include "llvm/IR/Operator.h"
 #include "llvm/IR/User.h"
 #include "llvm/Support/Casting.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Debug.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/LEB128.h"
+#include "llvm/Support/MD5.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/PassAnalysisSupport.h"
 #include "../RangeAnalysis/RangeAnalysis.h"
 
 using namespace llvm;
+using namespace sraa;
 
 extern unsigned MAX_BIT_INT;
 extern APInt Min;
 extern APInt Max;
 extern APInt Zero;
 
-Primitives StrictRelations::P;
-
 
 STATISTIC(NumVariablesConst, "Number of variables in constraints");
 STATISTIC(NumConstraints, "Number of constraints");
 STATISTIC(NumResolve, "Number of resolve operations");
+STATISTIC(NumComponents, "Number of variable graph components");
+STATISTIC(NumCollapsed, "Number of variables collapsed into another");
+STATISTIC(NumSolverTasks, "Number of components solved in parallel");
+STATISTIC(NumLazySolves, "Number of components solved on demand");
+STATISTIC(NumCacheHits, "Number of alias queries answered by the cache");
+STATISTIC(NumCacheMisses, "Number of alias queries missed by the cache");
+STATISTIC(NumCacheEvictions, "Number of alias cache entries evicted");
 STATISTIC(NumNodes, "Number of dep graph nodes");
 STATISTIC(NumEdges, "Number of dep graph edges");
 STATISTIC(NumQueries, "Number of alias queries received");
@@ -42,6 +57,96 @@ STATISTIC(NumNoAlias1, "Number of NoAlias answers in test 1");
 STATISTIC(NumNoAlias2, "Number of NoAlias answers in test 2");
 STATISTIC(NumNoAlias3, "Number of NoAlias answers in test 3");
 STATISTIC(NumEvil, "Number of evil things that happened");
+STATISTIC(NumUpdates, "Number of incremental updates");
+STATISTIC(NumFunctionsUpdated, "Number of functions collected again by updates");
+STATISTIC(NumConstraintsRetracted, "Number of constraints retracted by updates");
+STATISTIC(NumConstraintsKept, "Number of constraints kept by updates");
+STATISTIC(NumNodesRetracted, "Number of dep graph nodes retracted by updates");
+STATISTIC(NumNodesKept, "Number of dep graph nodes kept by updates");
+STATISTIC(NumVariablesResolved, "Number of variables solved again by updates");
+STATISTIC(NumVariablesKept, "Number of variables whose relations updates kept");
+STATISTIC(NumResultsLoaded, "Number of solutions read from the cache directory");
+STATISTIC(NumResultsSaved, "Number of solutions written to the cache directory");
+
+enum SolverKind { WorkListSolver, KernelSolver };
+static cl::opt<SolverKind> Solver("sraa-solver",
+  cl::desc("Solver used for the strict relations constraints"),
+  cl::init(WorkListSolver),
+  cl::values(
+    clEnumValN(WorkListSolver, "worklist", "Constraint objects (default)"),
+    clEnumValN(KernelSolver, "kernel", "Typed constraint kernel"),
+    clEnumValEnd));
+
+static cl::opt<unsigned> Threads("sraa-threads",
+  cl::desc("Number of threads solving the constraints (implies the kernel "
+           "solver when greater than 1)"),
+  cl::init(1));
+
+static cl::opt<unsigned> CacheSize("sraa-cache-size",
+  cl::desc("Maximum number of cached alias verdicts (0 disables the cache)"),
+  cl::init(1 << 16));
+
+static cl::opt<bool> Lazy("sraa-lazy",
+  cl::desc("Solve the constraints of a variable only when it is queried "
+           "(uses the kernel solver)"),
+  cl::init(false));
+
+static cl::opt<bool> Collapse("sraa-collapse",
+  cl::desc("Collapse cycles of <= and == constraints before solving"),
+  cl::init(false));
+
+static cl::opt<std::string> CacheDir("sraa-cache-dir",
+  cl::desc("Directory where solved strict relations are kept between runs, "
+           "keyed by a hash of the module"),
+  cl::init(""));
+
+static cl::opt<bool> Freeze("sraa-freeze",
+  cl::desc("Answer queries from a read-only index built after solving, and "
+           "free the solver data (ignored in lazy mode)"),
+  cl::init(false));
+
+enum TimingKind { NoTiming, TextTiming, JSONTiming };
+static cl::opt<TimingKind> Timing("sraa-timing",
+  cl::desc("Report of the time and memory of each phase, and of the latency "
+           "of the alias tests"),
+  cl::init(NoTiming),
+  cl::values(
+    clEnumValN(NoTiming, "none", "Nothing is measured (default)"),
+    clEnumValN(TextTiming, "text", "Printed as text"),
+    clEnumValN(JSONTiming, "json", "Printed as a single line of JSON"),
+    clEnumValEnd));
+
+static cl::opt<std::string> RecordTrace("sraa-record-trace",
+  cl::desc("File where the alias queries the analysis receives are written, "
+           "for -sraa-replay"),
+  cl::init(""));
+
+enum CheckKind { NoCheck, BatchCheck, UpdatesCheck, NewPMCheck };
+static cl::opt<CheckKind> Verify("sraa-verify",
+  cl::desc("Answer the queries of -aa-eval another way, and print the pairs "
+           "where the verdicts differ from those of single queries"),
+  cl::init(NoCheck), cl::Hidden,
+  cl::values(
+    clEnumValN(BatchCheck, "batch", "aliasMany"),
+    clEnumValN(UpdatesCheck, "updates",
+               "Single queries after updating every function"),
+    clEnumValN(NewPMCheck, "newpm",
+               "The analysis of the new pass manager"),
+    clEnumValEnd));
+
+static cl::opt<std::string> ReplayTrace("sraa-replay-trace",
+  cl::desc("Trace of alias queries replayed by -sraa-replay"),
+  cl::init(""));
+
+enum ScheduleKind { FIFOSchedule, SCCSchedule };
+static cl::opt<ScheduleKind> Schedule("sraa-schedule",
+  cl::desc("Order in which the solver visits the constraints"),
+  cl::init(FIFOSchedule),
+  cl::values(
+    clEnumValN(FIFOSchedule, "fifo", "Collection order (default)"),
+    clEnumValN(SCCSchedule, "scc",
+               "Topological order of the variable graph components"),
+    clEnumValEnd));
 
 // Register this pass...
 char StrictRelations::ID = 0;
@@ -49,18 +154,17 @@ static RegisterPass<StrictRelations> X("sraa",
                         "Strict relations alias analysis", false, false);
 static RegisterAnalysisGroup<AliasAnalysis> E(X);
 
+char FunctionStrictRelations::ID = 0;
+static RegisterPass<FunctionStrictRelations> XF("sraa-func",
+       "Strict relations alias analysis, one function at a time", false, false);
+static RegisterAnalysisGroup<AliasAnalysis> EF(XF);
+
+char AliasTraceReplay::ID = 0;
+static RegisterPass<AliasTraceReplay> XR("sraa-replay",
+                        "Replay of a trace of alias queries", false, true);
+
 ////////////////////////////////////////////////////////////////////////////////
 // Primitives class implementation
-//Returns the sum of previous elements of vector
-int Primitives::getSumBehind(std::vector<int> v, unsigned int i) {
-  int s = 0;
-  if(i > v.size())
-    i = v.size();
-  for(int j = i-1; j >= 0; j--)
-    s += v[j];
-  return s;
-}
-
 //Returns the type of the ith element inside type
 Type* Primitives::getTypeInside(Type* type, int i) {
   if(type->isPointerTy())
@@ -78,9 +182,9 @@ Type* Primitives::getTypeInside(Type* type, int i) {
 //Returns the number of primitive elements of type
 int Primitives::getNumPrimitives(Type* type) {
   //Verifies if this number of primitives was calculated already
-  for(unsigned int i = 0; i < NumPrimitives.size(); i++)
-    if(NumPrimitives[i]->type == type)
-      return NumPrimitives[i]->num;
+  auto it = NumPrimitives.find(type);
+  if(it != NumPrimitives.end())
+    return it->second;
   
   //if not
   int np;
@@ -109,73 +213,71 @@ int Primitives::getNumPrimitives(Type* type) {
     //assert(np > 0 && "Unrecognized type");
   }
   
-  NumPrimitives.insert(NumPrimitives.end(), new NumPrimitive(type, np));
+  NumPrimitives[type] = np;
   return np;
 }
 
-//Returns a vector with the primitive layout of type
-std::vector<int> Primitives::getPrimitiveLayout(Type* type) {
+//Returns the primitive layout of type
+const Primitives::PrimitiveLayout&
+Primitives::getPrimitiveLayout(Type* type) {
   //Verifies if this layout was calculated already
-  for(unsigned int i = 0; i < PrimitiveLayouts.size(); i++)
-    if(PrimitiveLayouts[i]->type == type)
-      return PrimitiveLayouts[i]->layout;
+  auto it = PrimitiveLayouts.find(type);
+  if(it != PrimitiveLayouts.end())
+    return it->second;
   
   //if not
-    
+  PrimitiveLayout pm;
   if(type->isArrayTy()) {
-    int num = type->getArrayNumElements();
-    std::vector<int> pm (num);
-    Type* arrtype = type->getArrayElementType();
-    int arrtypenum = getNumPrimitives(arrtype); 
-    for(int i = 0; i < num; i++)
-      pm[i] = arrtypenum;
-    PrimitiveLayouts.insert(PrimitiveLayouts.end(), 
-      new PrimitiveLayout(type, pm));
-    return pm;
+    pm.numElements = type->getArrayNumElements();
+    pm.elementSize = getNumPrimitives(type->getArrayElementType());
   } else if(type->isStructTy()) {
-    int num = type->getStructNumElements();
-    std::vector<int> pm (num);
-    for(int i = 0; i < num; i++) {
+    pm.numElements = type->getStructNumElements();
+    pm.elementSize = 0;
+    pm.prefix.resize(pm.numElements + 1);
+    pm.prefix[0] = 0;
+    for(unsigned i = 0; i < pm.numElements; i++) {
       Type* structelemtype = type->getStructElementType(i);
-      pm[i] = getNumPrimitives(structelemtype);
+      pm.prefix[i + 1] = pm.prefix[i] + getNumPrimitives(structelemtype);
     }
-    PrimitiveLayouts.insert(PrimitiveLayouts.end(), 
-      new PrimitiveLayout(type, pm));
-    return pm;
   } else if(type->isVectorTy()) {
-    int num = type->getVectorNumElements();
-    std::vector<int> pm (num); 
-    Type* arrtype = type->getVectorElementType();
-    int arrtypenum = getNumPrimitives(arrtype); 
-    for(int i = 0; i < num; i++)
-      pm[i] = arrtypenum;
-    PrimitiveLayouts.insert(PrimitiveLayouts.end(), 
-      new PrimitiveLayout(type, pm));
-    return pm;
+    pm.numElements = type->getVectorNumElements();
+    pm.elementSize = getNumPrimitives(type->getVectorElementType());
   } else {
-    std::vector<int> pm (1);
-    pm[0] = 1;
-    PrimitiveLayouts.insert(PrimitiveLayouts.end(), 
-      new PrimitiveLayout(type, pm));
-    return pm;
+    pm.numElements = 1;
+    pm.elementSize = 1;
   }
+  return PrimitiveLayouts[type] = std::move(pm);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 // StrictRelations definitions
+// Prints the profile in the format -sraa-timing asks for
+static void printTiming(const Profile &P) {
+  if(Timing == JSONTiming) {
+    P.printPhasesJSON(errs());
+  } else if(Timing == TextTiming) {
+    errs() << "------------------------------------------\n";
+    errs() << "                Times                     \n";
+    errs() << "------------------------------------------\n";
+    errs() << "Total time: " << P.getTotalNanoseconds() * 1e-9 << "\n";
+    P.printPhases(errs());
+    errs() << "------------------------------------------\n";
+  }
+}
+
 StrictRelations::~StrictRelations() {
-  phases += test1 + test2 + test3;
-  errs() << "------------------------------------------\n";
-  errs() << "                Times                     \n";
-  errs() << "------------------------------------------\n";
-  errs() << "Total time: " << phases << "\n";
-  errs() << "Constraint collection time: " << phase1 << "\n";
-  errs() << "Dependence graph time: " << phase2 << "\n";
-  errs() << "Worklist time: " << phase3 << "\n";
-  errs() << "Test 1 time: " << test1 << "\n";
-  errs() << "Test 2 time: " << test2 << "\n";
-  errs() << "Test 3 time: " << test3 << "\n";
-  errs() << "------------------------------------------\n";
+  if(reportTiming)
+    printTiming(prof);
+}
+
+// Runs an alias test, measuring its latency unless timing is off
+template <class F>
+static bool timeTest(Profile::Histogram *H, F Test) {
+  if(Timing == NoTiming) return Test();
+  uint64_t start = Profile::ticks();
+  bool result = Test();
+  H->add(Profile::ticks() - start);
+  return result;
 }
 
 void StrictRelations::getAnalysisUsage(AnalysisUsage &AU) const {
@@ -184,13 +286,38 @@ void StrictRelations::getAnalysisUsage(AnalysisUsage &AU) const {
   AU.setPreservesAll();
 }
 
+// Everything built for the module lives in the arenas, so dropping it is a
+// matter of freeing their slabs
+void StrictRelations::releaseMemory() {
+  delete kernel;
+  kernel = NULL;
+  delete wle;
+  wle = NULL;
+  nodes.clear();
+  nodeClasses.clear();
+  allocSites.clear();
+  variables.clear();
+  cache.clear();
+  functions.clear();
+  nodeJoins.clear();
+  delete arena;
+  arena = NULL;
+  delete constraintArena;
+  constraintArena = NULL;
+  index.clear();
+  frozen = false;
+}
+
 // Compares Values
 StrictRelations::CompareResult StrictRelations::compareValues(const Value* V1,
                                                               const Value* V2) {
-  if(variables.count(V1) and variables.count(V2)){
-    if(variables[V1]->GT.count(variables[V2]))
+  VarId v1, v2;
+  if(lookupVar(V1, v1) and lookupVar(V2, v2)){
+    solveFor(v1);
+    solveFor(v2);
+    if(isLT(v1, v2))
       return L;
-    else if(variables[V1]->LT.count(variables[V2]))
+    else if(isGT(v1, v2))
       return G;
   }
   Range r1, r2;
@@ -211,6 +338,44 @@ StrictRelations::CompareResult StrictRelations::compareValues(const Value* V1,
   return N;
 }
 
+bool StrictRelations::QueryCache::lookup(unsigned A, unsigned B,
+                                         unsigned &Test) {
+  if(capacity == 0) return false;
+  Key k = getKey(A, B);
+  auto it = young.find(k);
+  if(it != young.end()) {
+    Test = it->second;
+    NumCacheHits++;
+    return true;
+  }
+  it = old.find(k);
+  if(it == old.end()) {
+    NumCacheMisses++;
+    return false;
+  }
+  Test = it->second;
+  old.erase(it);
+  NumCacheHits++;
+  insert(A, B, Test);
+  return true;
+}
+
+void StrictRelations::QueryCache::insert(unsigned A, unsigned B,
+                                         unsigned Test) {
+  if(capacity == 0) return;
+  // Each generation holds half of the entries
+  if(young.size() >= (capacity + 1) / 2) {
+    NumCacheEvictions += old.size();
+    std::swap(young, old);
+    young.clear();
+  }
+  young[getKey(A, B)] = Test;
+}
+
+void StrictRelations::solveFor(VarId v) {
+  if(kernel) kernel->solveFor(v);
+}
+
 // Compares GEPs by comparing pairs of operands
 bool StrictRelations::disjointGEPs( const GetElementPtrInst* G1,
                                     const GetElementPtrInst* G2) {
@@ -247,6 +412,29 @@ bool StrictRelations::disjointGEPs( const GetElementPtrInst* G1,
   else return false;
 }
 
+void StrictRelations::countNoAlias(unsigned Test) {
+  noAliasCount[Test - 1]++;
+  NumNoAlias++;
+  if(Test == 1) NumNoAlias1++;
+  else if(Test == 2) NumNoAlias2++;
+  else NumNoAlias3++;
+}
+
+// Adds the offsets from n up to its ancestor a, one edge at a time
+static Range getOffset(StrictRelations::DepNode* n,
+                       StrictRelations::DepNode* a) {
+  Range offset = Range(Zero,Zero);
+  while(n != a) {
+    offset = offset.add(n->up->range);
+    n = n->up->out;
+  }
+  return offset;
+}
+
+static unsigned findComponents
+                        (const std::vector< SmallVector<unsigned, 4> > &succs,
+                         std::vector<unsigned> &component);
+
 bool diff(Range r1, Range r2){
   if(r1.getLower().sgt(r2.getUpper())) return true;
   else if(r2.getLower().sgt(r1.getUpper())) return true;
@@ -255,197 +443,570 @@ bool diff(Range r1, Range r2){
 
 AliasResult 
 StrictRelations::alias(const MemoryLocation &LocA, const MemoryLocation &LocB) {
+  AliasResult R = getAliasResult(LocA, LocB);
+  if(trace) recordQuery(LocA, LocB, R);
+  if(R != MayAlias) return R;
+  return AliasAnalysis::alias(LocA, LocB);
+}
+
+AliasResult StrictRelations::getAliasResult(const MemoryLocation &LocA,
+                                            const MemoryLocation &LocB) {
   NumQueries++;
-  const Value *p1, *p2;
-  p1 = LocA.Ptr;
-  p2 = LocB.Ptr;
-  if(nodes[p1]->mustalias == nodes[p2]->mustalias) return MustAlias;
+  // Pointers the analysis has not seen, such as those of other functions
+  // when a single one is analysed
+  QueryPointer Q1, Q2;
+  if(!resolve(LocA.Ptr, Q1) or !resolve(LocB.Ptr, Q2)) return MayAlias;
+  unsigned c1 = Q1.cls;
+  unsigned c2 = Q2.cls;
+  if(c1 == c2) return MustAlias;
+  
+  // Pointers in the same must alias class are the same pointer, so a
+  // NoAlias holds for every pair of members of the two classes. A hit is
+  // credited to the test that proved it, so that the counts of the tests
+  // add up to the NoAlias answers.
+  unsigned test;
+  if(cache.lookup(c1, c2, test)) {
+    countNoAlias(test);
+    return NoAlias;
+  }
   
-  bool t3 = aliastest3(p1, p2);
-  if(t3) { NumNoAlias++; return NoAlias;}
+  if(timeTest(testLatency[2], [&]{ return aliastest3(Q1, Q2); }))
+    test = 3;
+  else if(timeTest(testLatency[1], [&]{ return aliastest2(Q1, Q2); }))
+    test = 2;
+  else if(timeTest(testLatency[0], [&]{ return aliastest1(Q1, Q2); }))
+    test = 1;
+  else
+    return MayAlias;
+  cache.insert(c1, c2, test);
+  countNoAlias(test);
+  return NoAlias;
+}
+
+SmallBitVector StrictRelations::aliasMany(const MemoryLocation &Loc,
+                                          ArrayRef<MemoryLocation> Others) {
+  uint64_t start = Timing != NoTiming ? Profile::ticks() : 0;
+  SmallBitVector Result(Others.size());
+  NumQueries += Others.size();
+  QueryPointer Q1;
+  if(!resolve(Loc.Ptr, Q1)) return Result;
   
-  bool t2 = aliastest2(p1, p2);
-  if(t2) { NumNoAlias++; return NoAlias;} 
+  SmallVector<QueryPointer, 16> Qs(Others.size());
+  SmallVector<bool, 16> known(Others.size());
+  VariableSet related;
+  if(Q1.hasVar) {
+    solveFor(Q1.var);
+    // The relations of Q1's variable are all in its own sets, so the
+    // representatives of the candidates are intersected with them, instead
+    // of looked up one by one
+    VariableSet candidates;
+    for(unsigned i = 0, e = Others.size(); i != e; ++i) {
+      known[i] = resolve(Others[i].Ptr, Qs[i]);
+      if(known[i] and Qs[i].hasVar)
+        candidates.insert(getRep(Qs[i].var));
+    }
+    findRelated(Q1.var, candidates, related);
+  } else {
+    for(unsigned i = 0, e = Others.size(); i != e; ++i)
+      known[i] = resolve(Others[i].Ptr, Qs[i]);
+  }
   
-  bool t1 = aliastest1(p1, p2);
-  if(t1) { NumNoAlias++; return NoAlias;}
+  for(unsigned i = 0, e = Others.size(); i != e; ++i) {
+    const QueryPointer &Q2 = Qs[i];
+    if(!known[i] or Q1.cls == Q2.cls) continue;
+    unsigned test;
+    if(cache.lookup(Q1.cls, Q2.cls, test)) {
+      countNoAlias(test);
+      Result.set(i);
+      continue;
+    }
     
-  if(t1 or t2 or t3){ NumNoAlias++; return NoAlias;}
-  else return AliasAnalysis::alias(LocA, LocB);
+    if(aliastest3(Q1, Q2))
+      test = 3;
+    else if((Q2.hasVar and related.count(getRep(Q2.var))) or
+            disjointBases(Q1, Q2))
+      test = 2;
+    else if(aliastest1(Q1, Q2))
+      test = 1;
+    else
+      continue;
+    cache.insert(Q1.cls, Q2.cls, test);
+    countNoAlias(test);
+    Result.set(i);
+  }
   
-  return AliasAnalysis::alias(LocA, LocB);   
+  if(Timing != NoTiming)
+    batchLatency->add(Profile::ticks() - start);
+  return Result;
 }
 
-bool StrictRelations::aliastest1(const Value* p1, const Value* p2) {
-  clock_t t;
-  t = clock();
+// Flags of the node for QueryIndex
+static unsigned char getFlags(const StrictRelations::DepNode* n) {
+  typedef StrictRelations::QueryIndex QI;
+  unsigned char flags = 0;
+  if(n->unk) flags |= QI::UnkFlag;
+  if(n->arg) flags |= QI::ArgFlag;
+  if(n->global) flags |= QI::GlobalFlag;
+  if(n->inedges.empty() and !n->arg and !n->alloca and !n->global)
+    flags |= QI::NoOriginFlag;
+  return flags;
+}
+
+// Pointers of F that -aa-eval asks about
+static void collectQueriedPointers(Function &F,
+                                   std::vector<MemoryLocation> &Locs) {
+  for(Argument &A : F.args())
+    if(A.getType()->isPointerTy())
+      Locs.push_back(MemoryLocation(&A, MemoryLocation::UnknownSize));
+  for(inst_iterator I = inst_begin(F), E = inst_end(F); I != E; ++I)
+    if(I->getType()->isPointerTy())
+      Locs.push_back(MemoryLocation(&*I, MemoryLocation::UnknownSize));
+}
+
+// Verdicts of Query for every pointer of each function that -aa-eval asks
+// about, against all the pointers of its function, in a fixed order
+static void getVerdicts(Module &M,
+                        function_ref<SmallBitVector(const MemoryLocation &,
+                                        ArrayRef<MemoryLocation>)> Query,
+                        std::vector<SmallBitVector> &Verdicts) {
+  std::vector<MemoryLocation> Locs;
+  for(Function &F : M) {
+    Locs.clear();
+    collectQueriedPointers(F, Locs);
+    for(auto &L : Locs) Verdicts.push_back(Query(L, Locs));
+  }
+}
+
+void StrictRelations::verify(Module &M) {
+  auto Single = [&](const MemoryLocation &Loc,
+                    ArrayRef<MemoryLocation> Others) {
+    SmallBitVector Result(Others.size());
+    for(unsigned j = 0, e = Others.size(); j != e; ++j)
+      if(getAliasResult(Loc, Others[j]) == NoAlias) Result.set(j);
+    return Result;
+  };
+  std::vector<SmallBitVector> Expected, Actual;
+  getVerdicts(M, Single, Expected);
   
-  if(nodes.count(p1) and nodes.count(p2)) {
-    DepNode* dp1 = nodes[p1];
-    DepNode* dp2 = nodes[p2];
-    
-    // Local tree verification
-    if(dp1->local_root == dp2->local_root) {
-      int index = -1;
-      DepNode* ancestor = NULL;
-      for(auto i : dp1->path_to_root) {
-        if(index > -1 and i.second.first > index) {
-          continue;
+  unsigned mismatches = 0;
+  auto compare = [&]() {
+    std::vector<MemoryLocation> Locs;
+    unsigned k = 0;
+    for(Function &F : M) {
+      Locs.clear();
+      collectQueriedPointers(F, Locs);
+      for(unsigned i = 0, e = Locs.size(); i != e; ++i, ++k)
+        for(unsigned j = 0; j != e; ++j) {
+          if(Expected[k][j] == Actual[k][j]) continue;
+          mismatches++;
+          errs() << "sraa: " << (Actual[k][j] ? "NoAlias" : "MayAlias")
+                 << " instead of " << (Expected[k][j] ? "NoAlias" : "MayAlias")
+                 << " on " << *Locs[i].Ptr << " and " << *Locs[j].Ptr << "\n";
         }
-        else if(dp2->path_to_root.count(i.first)) {  
-          if(index == -1 or i.second.first < index) {
-           index = i.second.first;
-           ancestor = i.first;
-          }
-        } 
-      }
-
-      if(diff(dp1->path_to_root[ancestor].second, dp2->path_to_root[ancestor].second)) {
-        NumNoAlias1++;
-        t = clock() - t;
-        test1 += ((float)t)/CLOCKS_PER_SEC;
-        return true;
-      }
     }
+    Actual.clear();
+  };
+  
+  switch(Verify) {
+  case BatchCheck:
+    getVerdicts(M, [&](const MemoryLocation &Loc,
+                       ArrayRef<MemoryLocation> Others) {
+      return aliasMany(Loc, Others);
+    }, Actual);
+    compare();
+    break;
+  case UpdatesCheck: {
+    // Every other function first, so that a frozen analysis collects the
+    // others again
+    std::vector<const Function*> Half, All;
+    for(Function &F : M) {
+      if(F.isDeclaration()) continue;
+      if(All.size() % 2 == 0) Half.push_back(&F);
+      All.push_back(&F);
+    }
+    for(auto Changed : {&Half, &All}) {
+      updateFunctions(M, *Changed);
+      getVerdicts(M, Single, Actual);
+      compare();
+    }
+    break;
   }
-  t = clock() - t;
-  test1 += ((float)t)/CLOCKS_PER_SEC;
-  return false;
+  case NewPMCheck: {
+    // The ranges are computed again by the analysis manager, from the same
+    // module
+    ModuleAnalysisManager AM;
+    AM.registerPass(InterProceduralRAAnalysis<Cousot>());
+    AM.registerPass(StrictRelationsAnalysis());
+    StrictRelationsAnalysis::Result &R =
+      AM.getResult<StrictRelationsAnalysis>(M);
+    getVerdicts(M, [&](const MemoryLocation &Loc,
+                       ArrayRef<MemoryLocation> Others) {
+      SmallBitVector Result(Others.size());
+      for(unsigned j = 0, e = Others.size(); j != e; ++j)
+        if(R.alias(Loc, Others[j]) == NoAlias) Result.set(j);
+      return Result;
+    }, Actual);
+    compare();
+    break;
+  }
+  case NoCheck:
+    return;
+  }
+  errs() << "sraa: " << Verify.ArgStr << " checked, " << mismatches
+         << " mismatches\n";
 }
 
-bool StrictRelations::aliastest2(const Value* p1, const Value* p2) {
-  clock_t t;
-  t = clock();
+bool StrictRelations::resolve(const Value* V, QueryPointer &Q) {
+  Q.v = V;
+  Q.gep = dyn_cast<GetElementPtrInst>(V);
+  Q.baseCls = 0;
+  if(frozen) {
+    unsigned i = index.lookup(V);
+    if(i == QueryIndex::None or !index.node[i]) return false;
+    Q.node = index.node[i];
+    Q.cls = index.cls[i];
+    Q.flags = index.flags[i];
+    Q.locs = &index.locs[i];
+    Q.var = index.var[i];
+    Q.hasVar = Q.var != QueryIndex::None;
+    if(Q.gep) {
+      unsigned base = index.lookup(Q.gep->getPointerOperand());
+      if(base != QueryIndex::None and index.node[base])
+        Q.baseCls = index.cls[base];
+      else
+        Q.gep = NULL;
+    }
+    return true;
+  }
   
-  if(!variables.count(p1)) variables[p1] = new StrictRelations::Variable(p1);
-  if(!variables.count(p2)) variables[p2] = new StrictRelations::Variable(p2);
-  Variable* v1 = variables[p1];
-  Variable* v2 = variables[p2];
-  if(v1->LT.count(v2) or v1->GT.count(v2)) {
-    NumNoAlias2++;
-    t = clock() - t;
-    test2 += ((float)t)/CLOCKS_PER_SEC;
+  auto it = nodes.find(V);
+  if(it == nodes.end()) return false;
+  Q.node = it->second;
+  Q.cls = nodeClasses.find(Q.node->id);
+  Q.flags = getFlags(Q.node);
+  Q.locs = &Q.node->locs;
+  Q.hasVar = variables.count(V);
+  Q.var = Q.hasVar ? variables.lookup(V) : 0;
+  if(Q.gep) {
+    auto base = nodes.find(Q.gep->getPointerOperand());
+    if(base != nodes.end())
+      Q.baseCls = nodeClasses.find(base->second->id);
+    else
+      Q.gep = NULL;
+  }
+  return true;
+}
+
+bool StrictRelations::lookupVar(const Value* V, VarId &v) {
+  if(frozen) {
+    unsigned i = index.lookup(V);
+    if(i == QueryIndex::None or index.var[i] == QueryIndex::None)
+      return false;
+    v = index.var[i];
     return true;
   }
-  if(const GetElementPtrInst* gep1 = dyn_cast<GetElementPtrInst>(p1))
-    if(const GetElementPtrInst* gep2 = dyn_cast<GetElementPtrInst>(p2)) {
-      if(nodes[gep1->getPointerOperand()]->mustalias == 
-                                  nodes[gep2->getPointerOperand()]->mustalias) { 
-        t = clock() - t;
-        test2 += ((float)t)/CLOCKS_PER_SEC;
-        if(disjointGEPs(gep1, gep2)) { 
-          NumNoAlias2++;
-          return true;
-        } else { return false; }
-      }
+  if(!variables.count(V)) return false;
+  v = variables.lookup(V);
+  return true;
+}
+
+void StrictRelations::findRelated(VarId v, VariableSet &Candidates,
+                                  VariableSet &Related) {
+  if(!frozen) {
+    VariableSet greater = Candidates;
+    Related = Candidates;
+    Related.intersectWith(variables.LT(v));
+    greater.intersectWith(variables.GT(v));
+    Related.unionWith(greater);
+    return;
+  }
+  // Both are sorted, so each row is merged with the candidates in one pass
+  ArrayRef<VarId> Rows[2] = { index.LT(v), index.GT(v) };
+  for(ArrayRef<VarId> Row : Rows) {
+    auto r = Row.begin(), re = Row.end();
+    for(auto c = Candidates.begin(), ce = Candidates.end();
+        c != ce and r != re; ++c) {
+      r = std::lower_bound(r, re, (VarId)*c);
+      if(r != re and *r == (VarId)*c) Related.insert(*c);
     }
-  t = clock() - t;
-  test2 += ((float)t)/CLOCKS_PER_SEC;
-  return false;
+  }
 }
 
-bool StrictRelations::aliastest3(const Value* p1, const Value* p2) {
-  clock_t t;
-  t = clock();
+bool StrictRelations::aliastest1(const QueryPointer &Q1,
+                                 const QueryPointer &Q2) {
+  DepNode* dp1 = Q1.node;
+  DepNode* dp2 = Q2.node;
   
-  DepNode* dp1 = nodes[p1];
-  DepNode* dp2 = nodes[p2];
-  
-  if(dp1->unk or dp2->unk) {
-    t = clock() - t;
-    test3 += ((float)t)/CLOCKS_PER_SEC;
-    return false;
+  // Local tree verification
+  if(dp1->local_root == dp2->local_root) {
+    // Closest node of dp1's path to the root that is also in dp2's path
+    DepNode* ancestor;
+    PathSum s1, s2;
+    if(dp1->top == dp2->top) {
+      ancestor = getCommonAncestor(dp1, dp2);
+      s1 = dp1->sum - ancestor->sum;
+      s2 = dp2->sum - ancestor->sum;
+    } else {
+      // Both trees hang from the same cycle, and dp2's path goes around it
+      // until it reaches the cycle node of dp1
+      ancestor = dp1->top;
+      DepNode* from = dp2->top;
+      PathSum around = ancestor->cycleSum - from->cycleSum;
+      if(ancestor->cyclePos < from->cyclePos)
+        around = around + from->cycleTotal;
+      s1 = dp1->sum;
+      s2 = dp2->sum + around;
+    }
+    
+    Range r1, r2;
+    if(!s1.getRange(r1)) r1 = getOffset(dp1, ancestor);
+    if(!s2.getRange(r2)) r2 = getOffset(dp2, ancestor);
+    if(diff(r1, r2))
+      return true;
+  }
+  return false;
+}
+
+bool StrictRelations::aliastest2(const QueryPointer &Q1,
+                                 const QueryPointer &Q2) {
+  // A pointer without a variable has no strict relations
+  if(Q1.hasVar and Q2.hasVar) {
+    VarId v1 = Q1.var;
+    VarId v2 = Q2.var;
+    solveFor(v1);
+    solveFor(v2);
+    if(isGT(v1, v2) or isLT(v1, v2))
+      return true;
   }
+  return disjointBases(Q1, Q2);
+}
+
+bool StrictRelations::disjointBases(const QueryPointer &Q1,
+                                    const QueryPointer &Q2) {
+  return Q1.gep and Q2.gep and Q1.baseCls == Q2.baseCls and
+         disjointGEPs(Q1.gep, Q2.gep);
+}
+
+bool StrictRelations::aliastest3(const QueryPointer &Q1,
+                                 const QueryPointer &Q2) {
+  typedef QueryIndex QI;
+  unsigned char f1 = Q1.flags;
+  unsigned char f2 = Q2.flags;
   
-  if(dp1->inedges.empty() and !dp1->arg and !dp1->alloca and !dp1->global) {
-    t = clock() - t;
-    test3 += ((float)t)/CLOCKS_PER_SEC;
+  if((f1 | f2) & QI::UnkFlag) {
     return false;
   }
   
-  if(dp2->inedges.empty() and !dp2->arg and !dp2->alloca and !dp2->global) {
-    t = clock() - t;
-    test3 += ((float)t)/CLOCKS_PER_SEC;
+  // Nodes without in-edges that are not arguments, allocas or globals
+  if((f1 | f2) & QI::NoOriginFlag) {
     return false;
   }
   
-  if(dp1->arg and !dp2->arg and !dp2->global) { 
-    NumNoAlias3++;
-    t = clock() - t;
-    test3 += ((float)t)/CLOCKS_PER_SEC;
+  if((f1 & QI::ArgFlag) and !(f2 & (QI::ArgFlag | QI::GlobalFlag))) { 
     return true;
   }
   
-  if(dp2->arg and !dp1->arg and !dp1->global) {
-    NumNoAlias3++;
-    t = clock() - t;
-    test3 += ((float)t)/CLOCKS_PER_SEC;
+  if((f2 & QI::ArgFlag) and !(f1 & (QI::ArgFlag | QI::GlobalFlag))) {
     return true;
   }
   
-  if(dp1->locs.empty() or dp2->locs.empty()) { 
-    t = clock() - t;
-    test3 += ((float)t)/CLOCKS_PER_SEC;
+  if(Q1.locs->empty() or Q2.locs->empty()) { 
     return false;
   }
   
-  for(auto i : dp1->locs)
-    if(dp2->locs.count(i)) {
-      t = clock() - t;
-      test3 += ((float)t)/CLOCKS_PER_SEC;
-      return false;
-    }
+  if(Q1.locs->intersects(*Q2.locs)) {
+    return false;
+  }
   
-  NumNoAlias3++;
-  t = clock() - t;
-  test3 += ((float)t)/CLOCKS_PER_SEC;
   return true;  
 }
 
 bool StrictRelations::runOnModule(Module &M) {
   InitializeAliasAnalysis(this, &M.getDataLayout());
-  RA = &getAnalysis<InterProceduralRACousot>();
-  wle = new WorkListEngine();
-  global_variable_translator = (void*) 
-                                new BitVectorPositionTranslator<Variable*>();
-  test1 = 0; test2 = 0; test3 = 0;
-  clock_t t;
-  t = clock();
+  analyze(M, getAnalysis<InterProceduralRACousot>());
+  if(!RecordTrace.empty())
+    openTrace(M);
+  
+  // Both would force the whole solution in lazy mode
+  if(!Lazy) {
+    for(VarId i = 0, e = variables.size(); i != e; ++i) {
+      if(variables.GT(i).intersects(variables.LT(i)))
+        NumEvil++;
+    }
+    
+    errs() << "-------------------------\nResults: \n";
+    for(VarId i = 0, e = variables.size(); i != e; ++i){
+      variables.printStrictRelations(i, errs());
+    }
+  }
+  if(Freeze)
+    freeze();
+  // Updates of a frozen analysis thaw it and freeze it again
+  if(Verify != NoCheck)
+    verify(M);
+  
+  DEBUG_WITH_TYPE("phases", errs() << "Finished.\n");
+  
+  return false;
+}
+
+void StrictRelations::analyze(Module &M, RangeAnalysis &R, Function *Scope) {
+  RA = &R;
+  scope = Scope;
+  cache.setCapacity(CacheSize);
+  prof.resetPhases();
+  analyzeModule(M);
+}
+
+// Runs every phase over the whole module
+void StrictRelations::analyzeModule(Module &M) {
+  releaseMemory();
+  arena = new AnalysisArena();
+  constraintArena = new ConstraintArena();
+  wle = new WorkListEngine(&variables);
+  uint64_t t = Timing != NoTiming ? Profile::ticks() : 0;
+  auto endPhase = [&](StringRef Name) {
+    if(Timing == NoTiming) return;
+    uint64_t now = Profile::ticks();
+    prof.updatePhase(Name, now - t);
+    t = now;
+  };
   
   DEBUG_WITH_TYPE("phases", errs() << "Collecting constraints.\n");  
   collectConstraintsFromModule(M);
   NumVariablesConst = variables.size();
-  t = clock() - t;
-  phase1 = ((float)t)/CLOCKS_PER_SEC;
+  endPhase("Constraint collection");
   
   DEBUG_WITH_TYPE("phases", errs() << "Building dependence graph.\n");  
   buildDepGraph(M);
+  endPhase("Dependence graph");
+  
+  DEBUG_WITH_TYPE("phases", errs() << "Propagating types.\n");  
   collectTypes();
   propagateTypes();
-  for(auto i :nodes) i.second->getPathToRoot();
-  t = clock() - t;
-  phase2 = ((float)t)/CLOCKS_PER_SEC;
+  endPhase("Propagation");
+  
+  DEBUG_WITH_TYPE("phases", errs() << "Building local trees.\n");  
+  buildForest();
+  endPhase("Local trees");
   
   DEBUG_WITH_TYPE("worklist", wle->printConstraints(errs()));
   DEBUG_WITH_TYPE("phases", errs() << "Running WorkList engine.\n");  
-  wle->solve();
-  t = clock() - t;
-  phase3 = ((float)t)/CLOCKS_PER_SEC;
+  if(Collapse)
+    wle->collapse();
+  if(Schedule == SCCSchedule)
+    wle->schedule();
+  kernel = NULL;
+  std::string resultsPath;
+  // The files are keyed by the whole module
+  if(!CacheDir.empty() and !scope)
+    resultsPath = getResultsPath(M);
+  if(!resultsPath.empty() and loadRelations(resultsPath)) {
+    NumResultsLoaded++;
+  } else if(Lazy) {
+    // Constraints are solved by the alias queries
+    kernel = new ConstraintKernel(*wle);
+  } else {
+    if(Solver == KernelSolver or Threads > 1) {
+      ConstraintKernel K(*wle);
+      K.solve(Threads);
+    } else {
+      wle->solve();
+    }
+    if(!resultsPath.empty())
+      saveRelations(resultsPath);
+  }
+  endPhase("Worklist");
+}
+
+// Files of the cache directory start with this tag, followed by the number
+// of variables and of constraints of the system they solve
+static const char ResultsMagic[] = "SRAA\x01";
+
+// Feeds what is written to it to an MD5 hash, so that the module is hashed
+// as it is printed, without holding its text
+namespace {
+class MD5Stream : public raw_ostream {
+  MD5 &Hash;
+  uint64_t Pos;
   
-  for(auto i : variables) {
-    if(i.second->GT.intersects(i.second->LT))
-      NumEvil++;
+  void write_impl(const char *Ptr, size_t Size) override {
+    Hash.update(ArrayRef<uint8_t>((const uint8_t*)Ptr, Size));
+    Pos += Size;
   }
+  uint64_t current_pos() const override { return Pos; }
   
-  errs() << "-------------------------\nResults: \n";
-  for(auto i : variables){
-    i.second->printStrictRelations(errs());
+public:
+  explicit MD5Stream(MD5 &H) : Hash(H), Pos(0) {}
+  ~MD5Stream() override { flush(); }
+};
+}
+
+// The relations depend on the whole module: shared constants and globals
+// link the constraints of different functions, and the ranges are
+// interprocedural. So the key hashes the IR of every global and function,
+// and the options that change the solution.
+std::string StrictRelations::getResultsPath(Module &M) {
+  MD5 Hash;
+  {
+    MD5Stream OS(Hash);
+    OS << M.getDataLayoutStr() << '\n' << (Collapse ? "collapse" : "") << '\n';
+    for(auto i = M.global_begin(), e = M.global_end(); i != e; i++)
+      OS << *i << '\n';
+    for(auto F = M.begin(), Fe = M.end(); F != Fe; F++)
+      F->print(OS);
   }
+  MD5::MD5Result Result;
+  Hash.final(Result);
+  SmallString<32> Name;
+  MD5::stringifyResult(Result, Name);
   
-  DEBUG_WITH_TYPE("phases", errs() << "Finished.\n");
-  phases = phase1 + phase2 + phase3;
+  SmallString<128> Path(CacheDir);
+  sys::path::append(Path, Twine("sraa-") + Name + ".bin");
+  return Path.str().str();
+}
+
+bool StrictRelations::loadRelations(StringRef Path) {
+  ErrorOr< std::unique_ptr<MemoryBuffer> > File = MemoryBuffer::getFile(Path);
+  if(!File) return false;
+  StringRef Data = (*File)->getBuffer();
   
-  return false;
+  std::string Header;
+  raw_string_ostream OS(Header);
+  OS << ResultsMagic;
+  encodeULEB128(variables.size(), OS);
+  encodeULEB128(wle->getNumConstraints(), OS);
+  OS.flush();
+  if(!Data.startswith(Header)) return false;
+  return variables.readRelations(Data.drop_front(Header.size()));
+}
+
+// Written to a unique file and renamed, so that concurrent runs never see
+// half a file
+void StrictRelations::saveRelations(StringRef Path) {
+  if(sys::fs::create_directories(CacheDir)) return;
+  SmallString<128> Model(CacheDir);
+  sys::path::append(Model, "sraa-%%%%%%%%.tmp");
+  int FD;
+  SmallString<128> TempPath;
+  if(sys::fs::createUniqueFile(Model, FD, TempPath)) return;
+  
+  bool Failed;
+  {
+    raw_fd_ostream OS(FD, /*shouldClose=*/true);
+    OS << ResultsMagic;
+    encodeULEB128(variables.size(), OS);
+    encodeULEB128(wle->getNumConstraints(), OS);
+    variables.writeRelations(OS);
+    OS.close();
+    Failed = OS.has_error();
+    OS.clear_error();
+  }
+  if(Failed or sys::fs::rename(TempPath, Path)) {
+    sys::fs::remove(TempPath);
+    return;
+  }
+  NumResultsSaved++;
 }
 
 // This function processes the indexes of a GEP operation and returns
@@ -470,14 +1031,25 @@ const Use* idx_end){
   } else {
     Range a = RA->getRange(indx);
     //updating lower and higher ranges
-    if(a.getLower().eq(Min))
-      r.setLower(Min);
-    else
-      r.setLower(APInt(MAX_BIT_INT, base_ptr_num_primitive) * a.getLower());
-    if(a.getUpper().eq(Max))
-      r.setUpper(Max);
-    else
-      r.setUpper(APInt(MAX_BIT_INT, base_ptr_num_primitive) * a.getUpper());
+    if(a.isNative()) {
+      // Products wrap around modulo 2^64, and the APInt keeps the low bits
+      uint64_t n = base_ptr_num_primitive;
+      int64_t lower = a.getNativeLower();
+      int64_t upper = a.getNativeUpper();
+      r.setLower(lower == a.getNativeMin() ? Min
+                 : APInt(MAX_BIT_INT, n * (uint64_t)lower, true));
+      r.setUpper(upper == a.getNativeMax() ? Max
+                 : APInt(MAX_BIT_INT, n * (uint64_t)upper, true));
+    } else {
+      if(a.getLower().eq(Min))
+        r.setLower(Min);
+      else
+        r.setLower(APInt(MAX_BIT_INT, base_ptr_num_primitive) * a.getLower());
+      if(a.getUpper().eq(Max))
+        r.setUpper(Max);
+      else
+        r.setUpper(APInt(MAX_BIT_INT, base_ptr_num_primitive) * a.getUpper());
+    }
   }
 
   //parse sequential indexes
@@ -485,7 +1057,7 @@ const Use* idx_end){
   for(int i = 1; (idx_begin + i) != idx_end; i++) {
     //Calculating Primitive Layout
     base_ptr_type = StrictRelations::P.getTypeInside(base_ptr_type, index);
-    std::vector<int> base_ptr_primitive_layout = 
+    const Primitives::PrimitiveLayout &base_ptr_primitive_layout = 
       StrictRelations::P.getPrimitiveLayout(base_ptr_type);
 
     Value* indx = (idx_begin + i)->get();
@@ -493,7 +1065,7 @@ const Use* idx_end){
       int constant = cint->getSExtValue();
 
       APInt addons(MAX_BIT_INT,
-        StrictRelations::P.getSumBehind(base_ptr_primitive_layout, constant));
+        base_ptr_primitive_layout.getSumBehind(constant));
       Range addon(addons, addons);
       r = r.add(addon);
 
@@ -503,10 +1075,10 @@ const Use* idx_end){
 
       r = r.add(
         Range(
-          APInt(MAX_BIT_INT, StrictRelations::P.getSumBehind
-                    (base_ptr_primitive_layout, a.getLower().getSExtValue())),
-          APInt(MAX_BIT_INT, StrictRelations::P.getSumBehind
-                    (base_ptr_primitive_layout, a.getUpper().getSExtValue()))
+          APInt(MAX_BIT_INT, base_ptr_primitive_layout.getSumBehind
+                    (a.getLower().getSExtValue())),
+          APInt(MAX_BIT_INT, base_ptr_primitive_layout.getSumBehind
+                    (a.getUpper().getSExtValue()))
         )
       );
       
@@ -516,546 +1088,344 @@ const Use* idx_end){
   return r;
 }
 
+// Creates a binary constraint of kind C between the variables of L and R and
+// hands it to the worklist engine
+template <class C>
+void StrictRelations::addConstraint(const Value* L, const Value* R) {
+  VarId l = variables.getOrInsert(L);
+  VarId r = variables.getOrInsert(R);
+  Constraint* c = constraintArena->create<C>(wle, l, r);
+  NumConstraints++;
+  variables.addConstraint(l, c);
+  variables.addConstraint(r, c);
+  wle->add(c);
+}
+
+// The function whose code defines V, if any
+static const Function* getFunctionOf(const Value* V) {
+  if(const Argument* A = dyn_cast_or_null<Argument>(V))
+    return A->getParent();
+  if(const Instruction* I = dyn_cast_or_null<Instruction>(V))
+    return I->getParent() ? I->getParent()->getParent() : NULL;
+  return NULL;
+}
+
 void StrictRelations::collectConstraintsFromModule(Module &M) {
+  if(scope) {
+    collectConstraintsFromFunction(*scope);
+    return;
+  }
+  for (Module::iterator m = M.begin(), me = M.end(); m != me; ++m)
+    collectConstraintsFromFunction(*m);
+}
+
+// A sigma and its comparison are in the same function, so each function is
+// collected on its own. What the function adds is recorded in its
+// FunctionInfo.
+void StrictRelations::collectConstraintsFromFunction(Function &F) {
+  VarId firstVar = variables.size();
+  unsigned firstConstraint = wle->getNumConstraints();
   // Map that holds the comparisons anf sigmas
   // cmp -> leftside<truesigma, falsesigma> , rightside<truesigma, falsesigma>
   std::map<const CmpInst*, std::pair< std::pair<const Value*, const Value*>,
                               std::pair<const Value*, const Value*> > > sigmas;
 
-// Going through the module collecting constraints and sigmas
-  for (Module::iterator m = M.begin(), me = M.end(); m != me; ++m) {
-    for (Function::iterator b = m->begin(), be = m->end(); b != be; ++b) {
-      for (BasicBlock::iterator I = b->begin(), ie = b->end(); I != ie; ++I) {
-        if(!variables.count(I)) variables[I] = new StrictRelations::Variable(I);
-        // Addition
-        if (isa<llvm::BinaryOperator>(&(*I))
-        && (&(*I))->getOpcode()==Instruction::Add) { 
-          // a = x + y
-          Value * op1 = I->getOperand(0);
-          Value * op2 = I->getOperand(1);
-          Range r1 = RA->getRange(op1);
-          Range r2 = RA->getRange(op2);
-          // Evaluating the first operand 
-          if(r1.getLower().eq(Zero) and r1.getUpper().eq(Zero)) {
-            // Case a = 0 + y then a = y
-            if(!variables.count(op2)) variables[op2] =
-                                          new StrictRelations::Variable(op2);
-            Constraint* c = new REQ(wle, variables[I], variables[op2]);
-            variables[I]->coalesce(variables[op2]);
-            NumConstraints++;
-            variables[I]->constraints.insert(c);
-            variables[op2]->constraints.insert(c);
-            wle->add(c);
+// Going through the function collecting constraints and sigmas
+  for (Function::iterator b = F.begin(), be = F.end(); b != be; ++b) {
+    for (BasicBlock::iterator I = b->begin(), ie = b->end(); I != ie; ++I) {
+      variables.getOrInsert(I);
+      // Addition
+      if (isa<llvm::BinaryOperator>(&(*I))
+      && (&(*I))->getOpcode()==Instruction::Add) { 
+        // a = x + y
+        Value * op1 = I->getOperand(0);
+        Value * op2 = I->getOperand(1);
+        Range r1 = RA->getRange(op1);
+        Range r2 = RA->getRange(op2);
+        // Evaluating the first operand 
+        if(r1.getLower().eq(Zero) and r1.getUpper().eq(Zero)) {
+          // Case a = 0 + y then a = y
+          addConstraint<REQ>(I, op2);
+          variables.coalesce(variables.lookup(I), variables.lookup(op2));
+        }
+        else if (r1.getLower().sgt(Zero)) {
+          // Case x > 0 then y < a
+          addConstraint<LT>(op2, I);
+        }
+        else if (r1.getLower().sge(Zero)) {
+          // Case x >= 0 then y <= a
+          addConstraint<LE>(op2, I);
+        }
+        else if (r1.getUpper().slt(Zero)) {
+          // Case x < 0 then a < y
+          addConstraint<LT>(I, op2);
+        }
+        else if (r1.getUpper().sle(Zero)) {
+          // Case x <= 0 then a <= y
+          addConstraint<LE>(I, op2);
+        }
+                  
+        // Evaluating the second operand 
+        if(r2.getLower().eq(Zero) and r2.getUpper().eq(Zero)) {
+          // Case a = x + 0 then a = x
+          addConstraint<REQ>(I, op1);
+          variables.coalesce(variables.lookup(I), variables.lookup(op1));
+        }
+        else if (r2.getLower().sgt(Zero)) {
+          // Case y > 0 then x < a
+          addConstraint<LT>(op1, I);
+        }
+        else if (r2.getLower().sge(Zero)) {
+          // Case y >= 0 then x <= a
+          addConstraint<LE>(op1, I);
+        }
+        else if (r2.getUpper().slt(Zero)) {
+          // Case y < 0 then a < x
+          addConstraint<LT>(I, op1);
+        }
+        else if (r2.getUpper().sle(Zero)) {
+          // Case y <= 0 then a <= x
+          addConstraint<LE>(I, op1);
+        }
+        
+      }
+      // Subtraction
+      else if (isa<llvm::BinaryOperator>(&(*I))
+      && (&(*I))->getOpcode()==Instruction::Sub) {
+        // a = x - y
+        Value * op1 = I->getOperand(0);
+        Value * op2 = I->getOperand(1);
+        Range r1 = RA->getRange(op1);
+        Range r2 = RA->getRange(op2);
+        // Evaluating the first operand 
+        if(r1.getLower().eq(Zero) and r1.getUpper().eq(Zero)) {
+          // Case a = 0 - y
+          if(r2.getLower().eq(Zero) and r2.getUpper().eq(Zero)){
+            // Case a = 0 - 0 then a = y
+            addConstraint<REQ>(I, op2);
+            variables.coalesce(variables.lookup(I), variables.lookup(op2));
           }
-          else if (r1.getLower().sgt(Zero)) {
-            // Case x > 0 then y < a
-            if(!variables.count(op2)) variables[op2] =
-                                          new StrictRelations::Variable(op2);
-            Constraint* c = new LT(wle, variables[op2], variables[I]);
-            NumConstraints++;
-            variables[I]->constraints.insert(c);
-            variables[op2]->constraints.insert(c);
-            wle->add(c);
+          else if (r2.getLower().sgt(Zero)) {
+            // Case y > 0 then a < y
+            addConstraint<LT>(I, op2);
           }
-          else if (r1.getLower().sge(Zero)) {
-            // Case x >= 0 then y <= a
-            if(!variables.count(op2)) variables[op2] =
-                                          new StrictRelations::Variable(op2);
-            Constraint* c = new LE(wle, variables[op2], variables[I]);
-            NumConstraints++;
-            variables[I]->constraints.insert(c);
-            variables[op2]->constraints.insert(c);
-            wle->add(c);
+          else if (r2.getLower().sge(Zero)) {
+            // Case y >= 0 then a <= y
+            addConstraint<LE>(I, op2);
           }
-          else if (r1.getUpper().slt(Zero)) {
-            // Case x < 0 then a < y
-            if(!variables.count(op2)) variables[op2] =
-                                          new StrictRelations::Variable(op2);
-            Constraint* c = new LT(wle, variables[I], variables[op2]);
-            NumConstraints++;
-            variables[I]->constraints.insert(c);
-            variables[op2]->constraints.insert(c);
-            wle->add(c);
+          else if (r2.getUpper().slt(Zero)) {
+            // Case y < 0 then y < a
+            addConstraint<LT>(op2, I);
           }
-          else if (r1.getUpper().sle(Zero)) {
-            // Case x <= 0 then a <= y
-            if(!variables.count(op2)) variables[op2] =
-                                          new StrictRelations::Variable(op2);
-            Constraint* c = new LE(wle, variables[I], variables[op2]);
-            NumConstraints++;
-            variables[I]->constraints.insert(c);
-            variables[op2]->constraints.insert(c);
-            wle->add(c);
+          else if (r2.getUpper().sle(Zero)) {
+            // Case y <= 0 then y <= a
+            addConstraint<LE>(op2, I);
           }
-                    
-          // Evaluating the second operand 
-          if(r2.getLower().eq(Zero) and r2.getUpper().eq(Zero)) {
-            // Case a = x + 0 then a = x
-            if(!variables.count(op1)) variables[op1] =
-                                          new StrictRelations::Variable(op1);
-            Constraint* c = new REQ(wle, variables[I], variables[op1]);
-            variables[I]->coalesce(variables[op1]);
-            NumConstraints++;
-            variables[I]->constraints.insert(c);
-            variables[op1]->constraints.insert(c);
-            wle->add(c);
+        }
+        else if (r1.getLower().sgt(Zero)) {
+          // Case x > 0 
+          if(r2.getLower().eq(Zero) and r2.getUpper().eq(Zero)){
+            // Case a = (>0) - 0 then y < a
+            addConstraint<LT>(op2, I);
           }
           else if (r2.getLower().sgt(Zero)) {
-            // Case y > 0 then x < a
-            if(!variables.count(op1)) variables[op1] =
-                                          new StrictRelations::Variable(op1);
-            Constraint* c = new LT(wle, variables[op1], variables[I]);
-            NumConstraints++;
-            variables[I]->constraints.insert(c);
-            variables[op1]->constraints.insert(c);
-            wle->add(c);
+            // Case y > 0, a = (>0) - (>0) then nothing 
           }
           else if (r2.getLower().sge(Zero)) {
-            // Case y >= 0 then x <= a
-            if(!variables.count(op1)) variables[op1] =
-                                          new StrictRelations::Variable(op1);
-            Constraint* c = new LE(wle, variables[op1], variables[I]);
-            NumConstraints++;
-            variables[I]->constraints.insert(c);
-            variables[op1]->constraints.insert(c);
-            wle->add(c);
+            // Case y >= 0, a = (>0) - (>=0)  then nothing
           }
           else if (r2.getUpper().slt(Zero)) {
-            // Case y < 0 then a < x
-            if(!variables.count(op1)) variables[op1] =
-                                          new StrictRelations::Variable(op1);
-            Constraint* c = new LT(wle, variables[I], variables[op1]);
-            NumConstraints++;
-            variables[I]->constraints.insert(c);
-            variables[op1]->constraints.insert(c);
-            wle->add(c);
+            // Case y < 0, a = (>0) - (<0) then y < a
+            addConstraint<LT>(op2, I);
           }
           else if (r2.getUpper().sle(Zero)) {
-            // Case y <= 0 then a <= x
-            if(!variables.count(op1)) variables[op1] =
-                                          new StrictRelations::Variable(op1);
-            Constraint* c = new LE(wle, variables[I], variables[op1]);
-            NumConstraints++;
-            variables[I]->constraints.insert(c);
-            variables[op1]->constraints.insert(c);
-            wle->add(c);
+            // Case y <= 0, a = (>0) - (<=0) then y < a 
+            addConstraint<LT>(op2, I);
           }
-          
         }
-        // Subtraction
-        else if (isa<llvm::BinaryOperator>(&(*I))
-        && (&(*I))->getOpcode()==Instruction::Sub) {
-          // a = x - y
-          Value * op1 = I->getOperand(0);
-          Value * op2 = I->getOperand(1);
-          Range r1 = RA->getRange(op1);
-          Range r2 = RA->getRange(op2);
-          // Evaluating the first operand 
-          if(r1.getLower().eq(Zero) and r1.getUpper().eq(Zero)) {
-            // Case a = 0 - y
-            if(r2.getLower().eq(Zero) and r2.getUpper().eq(Zero)){
-              // Case a = 0 - 0 then a = y
-              if(!variables.count(op2)) variables[op2] =
-                                          new StrictRelations::Variable(op2);
-              Constraint* c = new REQ(wle, variables[I], variables[op2]);
-              variables[I]->coalesce(variables[op2]);
-              NumConstraints++;
-              variables[I]->constraints.insert(c);
-              variables[op2]->constraints.insert(c);
-              wle->add(c);
-            }
-            else if (r2.getLower().sgt(Zero)) {
-              // Case y > 0 then a < y
-              if(!variables.count(op2)) variables[op2] =
-                                          new StrictRelations::Variable(op2);
-              Constraint* c = new LT(wle, variables[I], variables[op2]);
-              NumConstraints++;
-              variables[I]->constraints.insert(c);
-              variables[op2]->constraints.insert(c);
-              wle->add(c);
-            }
-            else if (r2.getLower().sge(Zero)) {
-              // Case y >= 0 then a <= y
-              if(!variables.count(op2)) variables[op2] =
-                                          new StrictRelations::Variable(op2);
-              Constraint* c = new LE(wle, variables[I], variables[op2]);
-              NumConstraints++;
-              variables[I]->constraints.insert(c);
-              variables[op2]->constraints.insert(c);
-              wle->add(c);
-            }
-            else if (r2.getUpper().slt(Zero)) {
-              // Case y < 0 then y < a
-              if(!variables.count(op2)) variables[op2] =
-                                          new StrictRelations::Variable(op2);
-              Constraint* c = new LT(wle, variables[op2], variables[I]);
-              NumConstraints++;
-              variables[I]->constraints.insert(c);
-              variables[op2]->constraints.insert(c);
-              wle->add(c);
-            }
-            else if (r2.getUpper().sle(Zero)) {
-              // Case y <= 0 then y <= a
-              if(!variables.count(op2)) variables[op2] =
-                                          new StrictRelations::Variable(op2);
-              Constraint* c = new LE(wle, variables[op2], variables[I]);
-              NumConstraints++;
-              variables[I]->constraints.insert(c);
-              variables[op2]->constraints.insert(c);
-              wle->add(c);
-            }
+        else if (r1.getLower().sge(Zero)) {
+          // Case x >= 0 
+          if(r2.getLower().eq(Zero) and r2.getUpper().eq(Zero)){
+            // Case a = (>=0) - 0 then y <= a
+            addConstraint<LE>(op2, I);
           }
-          else if (r1.getLower().sgt(Zero)) {
-            // Case x > 0 
-            if(r2.getLower().eq(Zero) and r2.getUpper().eq(Zero)){
-              // Case a = (>0) - 0 then y < a
-              if(!variables.count(op2)) variables[op2] =
-                                          new StrictRelations::Variable(op2);
-              Constraint* c = new LT(wle, variables[op2], variables[I]);
-              NumConstraints++;
-              variables[I]->constraints.insert(c);
-              variables[op2]->constraints.insert(c);
-              wle->add(c);
-            }
-            else if (r2.getLower().sgt(Zero)) {
-              // Case y > 0, a = (>0) - (>0) then nothing 
-            }
-            else if (r2.getLower().sge(Zero)) {
-              // Case y >= 0, a = (>0) - (>=0)  then nothing
-            }
-            else if (r2.getUpper().slt(Zero)) {
-              // Case y < 0, a = (>0) - (<0) then y < a
-              if(!variables.count(op2)) variables[op2] =
-                                          new StrictRelations::Variable(op2);
-              Constraint* c = new LT(wle, variables[op2], variables[I]);
-              NumConstraints++;
-              variables[I]->constraints.insert(c);
-              variables[op2]->constraints.insert(c);
-              wle->add(c);
-            }
-            else if (r2.getUpper().sle(Zero)) {
-              // Case y <= 0, a = (>0) - (<=0) then y < a 
-              if(!variables.count(op2)) variables[op2] =
-                                          new StrictRelations::Variable(op2);
-              Constraint* c = new LT(wle, variables[op2], variables[I]);
-              NumConstraints++;
-              variables[I]->constraints.insert(c);
-              variables[op2]->constraints.insert(c);
-              wle->add(c);
-            }
+          else if (r2.getLower().sgt(Zero)) {
+            // Case y > 0, a = (>=0) - (>0) then nothing 
           }
-          else if (r1.getLower().sge(Zero)) {
-            // Case x >= 0 
-            if(r2.getLower().eq(Zero) and r2.getUpper().eq(Zero)){
-              // Case a = (>=0) - 0 then y <= a
-              if(!variables.count(op2)) variables[op2] =
-                                          new StrictRelations::Variable(op2);
-              Constraint* c = new LE(wle, variables[op2], variables[I]);
-              NumConstraints++;
-              variables[I]->constraints.insert(c);
-              variables[op2]->constraints.insert(c);
-              wle->add(c);
-            }
-            else if (r2.getLower().sgt(Zero)) {
-              // Case y > 0, a = (>=0) - (>0) then nothing 
-            }
-            else if (r2.getLower().sge(Zero)) {
-              // Case y >= 0, a = (>=0) - (>=0)  then nothing
-            }
-            else if (r2.getUpper().slt(Zero)) {
-              // Case y < 0, a = (>=0) - (<0) then y < a
-              if(!variables.count(op2)) variables[op2] =
-                                          new StrictRelations::Variable(op2);
-              Constraint* c = new LT(wle, variables[op2], variables[I]);
-              NumConstraints++;
-              variables[I]->constraints.insert(c);
-              variables[op2]->constraints.insert(c);
-              wle->add(c);
-            }
-            else if (r2.getUpper().sle(Zero)) {
-              // Case y <= 0, a = (>=0) - (<=0) then y <= a 
-              if(!variables.count(op2)) variables[op2] =
-                                          new StrictRelations::Variable(op2);
-              Constraint* c = new LE(wle, variables[op2], variables[I]);
-              NumConstraints++;
-              variables[I]->constraints.insert(c);
-              variables[op2]->constraints.insert(c);
-              wle->add(c);
-            }
+          else if (r2.getLower().sge(Zero)) {
+            // Case y >= 0, a = (>=0) - (>=0)  then nothing
           }
-          else if (r1.getUpper().slt(Zero)) {
-            // Case x < 0 
-            if(r2.getLower().eq(Zero) and r2.getUpper().eq(Zero)){
-              // Case a = (<0) - 0 then a < y 
-              if(!variables.count(op2)) variables[op2] =
-                                          new StrictRelations::Variable(op2);
-              Constraint* c = new LT(wle, variables[I], variables[op2]);
-              NumConstraints++;
-              variables[I]->constraints.insert(c);
-              variables[op2]->constraints.insert(c);
-              wle->add(c);
-            }
-            else if (r2.getLower().sgt(Zero)) {
-              // Case y > 0, a = (<0) - (>0) then  a < y
-              if(!variables.count(op2)) variables[op2] =
-                                          new StrictRelations::Variable(op2);
-              Constraint* c = new LT(wle, variables[I], variables[op2]);
-              NumConstraints++;
-              variables[I]->constraints.insert(c);
-              variables[op2]->constraints.insert(c);
-              wle->add(c);
-            }
-            else if (r2.getLower().sge(Zero)) {
-              // Case y >= 0, a = (<0) - (>=0)  then a < y
-              if(!variables.count(op2)) variables[op2] =
-                                          new StrictRelations::Variable(op2);
-              Constraint* c = new LT(wle, variables[I], variables[op2]);
-              NumConstraints++;
-              variables[I]->constraints.insert(c);
-              variables[op2]->constraints.insert(c);
-              wle->add(c);
-            }
-            else if (r2.getUpper().slt(Zero)) {
-              // Case y < 0, a = (<0) - (<0) then nothing
-            }
-            else if (r2.getUpper().sle(Zero)) {
-              // Case y <= 0, a = (<0) - (<=0) then  nothing
-            }
+          else if (r2.getUpper().slt(Zero)) {
+            // Case y < 0, a = (>=0) - (<0) then y < a
+            addConstraint<LT>(op2, I);
           }
-          else if (r1.getUpper().sle(Zero)) {
-            // Case x <= 0 
-            if(r2.getLower().eq(Zero) and r2.getUpper().eq(Zero)){
-              // Case a = (<=0) - 0 then a <= y 
-              if(!variables.count(op2)) variables[op2] =
-                                          new StrictRelations::Variable(op2);
-              Constraint* c = new LE(wle, variables[I], variables[op2]);
-              NumConstraints++;
-              variables[I]->constraints.insert(c);
-              variables[op2]->constraints.insert(c);
-              wle->add(c);
-            }
-            else if (r2.getLower().sgt(Zero)) {
-              // Case y > 0, a = (<=0) - (>0) then  a < y
-              if(!variables.count(op2)) variables[op2] =
-                                          new StrictRelations::Variable(op2);
-              Constraint* c = new LT(wle, variables[I], variables[op2]);
-              NumConstraints++;
-              variables[I]->constraints.insert(c);
-              variables[op2]->constraints.insert(c);
-              wle->add(c);
-            }
-            else if (r2.getLower().sge(Zero)) {
-              // Case y >= 0, a = (<=0) - (>=0)  then a <= y
-              if(!variables.count(op2)) variables[op2] =
-                                          new StrictRelations::Variable(op2);
-              Constraint* c = new LE(wle, variables[I], variables[op2]);
-              NumConstraints++;
-              variables[I]->constraints.insert(c);
-              variables[op2]->constraints.insert(c);
-              wle->add(c);
-            }
-            else if (r2.getUpper().slt(Zero)) {
-              // Case y < 0, a = (<=0) - (<0) then nothing
-            }
-            else if (r2.getUpper().sle(Zero)) {
-              // Case y <= 0, a = (<=0) - (<=0) then  nothing
-            }
+          else if (r2.getUpper().sle(Zero)) {
+            // Case y <= 0, a = (>=0) - (<=0) then y <= a 
+            addConstraint<LE>(op2, I);
           }
-          
-          
-          // Evaluating the second operand 
-          if(r2.getLower().eq(Zero) and r2.getUpper().eq(Zero)) {
-            // Case a = x - 0 then a = x
-              if(!variables.count(op1)) variables[op1] =
-                                          new StrictRelations::Variable(op1);
-            Constraint* c = new REQ(wle, variables[I], variables[op1]);
-            variables[I]->coalesce(variables[op1]);
-            NumConstraints++;
-            variables[I]->constraints.insert(c);
-            variables[op1]->constraints.insert(c);
-            wle->add(c);
+        }
+        else if (r1.getUpper().slt(Zero)) {
+          // Case x < 0 
+          if(r2.getLower().eq(Zero) and r2.getUpper().eq(Zero)){
+            // Case a = (<0) - 0 then a < y 
+            addConstraint<LT>(I, op2);
           }
           else if (r2.getLower().sgt(Zero)) {
-            // Case y > 0 then a < x
-              if(!variables.count(op1)) variables[op1] =
-                                          new StrictRelations::Variable(op1);
-            Constraint* c = new LT(wle, variables[I], variables[op1]);
-            NumConstraints++;
-            variables[I]->constraints.insert(c);
-            variables[op1]->constraints.insert(c);
-            wle->add(c);
+            // Case y > 0, a = (<0) - (>0) then  a < y
+            addConstraint<LT>(I, op2);
           }
           else if (r2.getLower().sge(Zero)) {
-            // Case y >= 0 then a <= x
-              if(!variables.count(op1)) variables[op1] =
-                                          new StrictRelations::Variable(op1);
-            Constraint* c = new LE(wle, variables[I], variables[op1]);
-            NumConstraints++;
-            variables[I]->constraints.insert(c);
-            variables[op1]->constraints.insert(c);
-            wle->add(c);
+            // Case y >= 0, a = (<0) - (>=0)  then a < y
+            addConstraint<LT>(I, op2);
           }
           else if (r2.getUpper().slt(Zero)) {
-            // Case y < 0 then x < a
-              if(!variables.count(op1)) variables[op1] =
-                                          new StrictRelations::Variable(op1);
-            Constraint* c = new LT(wle, variables[op1], variables[I]);
-            NumConstraints++;
-            variables[I]->constraints.insert(c);
-            variables[op1]->constraints.insert(c);
-            wle->add(c);
+            // Case y < 0, a = (<0) - (<0) then nothing
           }
           else if (r2.getUpper().sle(Zero)) {
-            // Case y <= 0 then x <= a
-              if(!variables.count(op1)) variables[op1] =
-                                          new StrictRelations::Variable(op1);
-            Constraint* c = new LE(wle, variables[op1], variables[I]);
-            NumConstraints++;
-            variables[I]->constraints.insert(c);
-            variables[op1]->constraints.insert(c);
-            wle->add(c);
+            // Case y <= 0, a = (<0) - (<=0) then  nothing
           }
         }
-        // GEP Instruction
-        else if (const GetElementPtrInst* p = dyn_cast<GetElementPtrInst>(I)) {
-          // Getting base pointer
-          const Value* base = p->getPointerOperand();
-          // Geting bit range of offset
-          Range r = processGEP (base, p->idx_begin(), p->idx_end());
-          if(r.getLower().eq(Zero) and r.getUpper().eq(Zero)) {
-            // Case p = b + 0 then p = b
-            if(!variables.count(base)) variables[base] =
-                                        new StrictRelations::Variable(base);
-            Constraint* c = new REQ(wle, variables[I], variables[base]);
-            variables[I]->coalesce(variables[base]);
-            NumConstraints++;
-            variables[I]->constraints.insert(c);
-            variables[base]->constraints.insert(c);
-            wle->add(c);
+        else if (r1.getUpper().sle(Zero)) {
+          // Case x <= 0 
+          if(r2.getLower().eq(Zero) and r2.getUpper().eq(Zero)){
+            // Case a = (<=0) - 0 then a <= y 
+            addConstraint<LE>(I, op2);
           }
-          else if (r.getLower().sgt(Zero)) {
-            // Case p = b + (>0) then b < p
-            if(!variables.count(base)) variables[base] =
-                                        new StrictRelations::Variable(base);
-            Constraint* c = new LT(wle, variables[base], variables[I]);
-            NumConstraints++;
-            variables[I]->constraints.insert(c);
-            variables[base]->constraints.insert(c);
-            wle->add(c);
+          else if (r2.getLower().sgt(Zero)) {
+            // Case y > 0, a = (<=0) - (>0) then  a < y
+            addConstraint<LT>(I, op2);
           }
-          else if (r.getLower().sge(Zero)) {
-            // Case p = b + (>=0) then b <= p
-            if(!variables.count(base)) variables[base] =
-                                        new StrictRelations::Variable(base);
-            Constraint* c = new LE(wle, variables[base], variables[I]);
-            NumConstraints++;
-            variables[I]->constraints.insert(c);
-            variables[base]->constraints.insert(c);
-            wle->add(c);
+          else if (r2.getLower().sge(Zero)) {
+            // Case y >= 0, a = (<=0) - (>=0)  then a <= y
+            addConstraint<LE>(I, op2);
           }
-          else if (r.getUpper().slt(Zero)) {
-            // Case p = b + (<0) then p < b
-            if(!variables.count(base)) variables[base] =
-                                        new StrictRelations::Variable(base);
-            Constraint* c = new LT(wle, variables[I], variables[base]);
-            NumConstraints++;
-            variables[I]->constraints.insert(c);
-            variables[base]->constraints.insert(c);
-            wle->add(c);
+          else if (r2.getUpper().slt(Zero)) {
+            // Case y < 0, a = (<=0) - (<0) then nothing
           }
-          else if (r.getUpper().sle(Zero)) {
-            // Case p = b + (<=0) then p <= b
-            if(!variables.count(base)) variables[base] =
-                                        new StrictRelations::Variable(base);
-            Constraint* c = new LE(wle, variables[I], variables[base]);
-            NumConstraints++;
-            variables[I]->constraints.insert(c);
-            variables[base]->constraints.insert(c);
-            wle->add(c);
+          else if (r2.getUpper().sle(Zero)) {
+            // Case y <= 0, a = (<=0) - (<=0) then  nothing
           }
         }
-        // Sigma
-        else if(isa<PHINode>(&(*I)) && (I->getNumOperands() == 1) ) {
-          const PHINode* p = dyn_cast<PHINode>(I);
-          
-          const BasicBlock* cmpBB = p->getIncomingBlock(0);
-
-          if(!isa<BranchInst>(cmpBB->getTerminator())) {
-            errs() << "Error on evaluating sigma!\n";
-            continue;
-          }
-          const BranchInst* br = dyn_cast<BranchInst>(cmpBB->getTerminator());
-          // Getting weather true or false sigma 
-          const BasicBlock* curBB = I->getParent();
-          bool trueSigma = curBB == br->getSuccessor(0);
-
-          if(!br->isConditional()) {
-            errs() << "Error on evaluating sigma!\n";
-            continue;
-          } 
-          const Value* cmpV = br->getCondition();
-
-          if (!isa<CmpInst>(cmpV)){
-            errs() << "Error on evaluating sigma!\n";
-            continue;
-          }
-          // Getting comparison instruction
-          const CmpInst* cmpInst = dyn_cast<CmpInst>(cmpV);
-          // Getting side of predicate
-          bool leftSide = p->getIncomingValue(0) == cmpInst->getOperand(0);
-          // Adding to sigmas structures
-          if(leftSide and trueSigma)
-            sigmas[cmpInst].first.first = p;
-          else if(leftSide and !trueSigma)
-            sigmas[cmpInst].first.second = p;
-          else if(!leftSide and trueSigma)
-            sigmas[cmpInst].second.first = p;
-          else if(!leftSide and !trueSigma)
-            sigmas[cmpInst].second.second = p;
-
-          // Adding eq constraint
-          const Value* op = p->getIncomingValue(0);
-          if(!variables.count(op)) variables[op] =
-                                          new StrictRelations::Variable(op);
-          Constraint* c = new EQ(wle, variables[I], variables[op]);
-
-          NumConstraints++;
-          variables[I]->constraints.insert(c);
-          variables[op]->constraints.insert(c);
-          wle->add(c);
+        
+        
+        // Evaluating the second operand 
+        if(r2.getLower().eq(Zero) and r2.getUpper().eq(Zero)) {
+          // Case a = x - 0 then a = x
+            addConstraint<REQ>(I, op1);
+            variables.coalesce(variables.lookup(I), variables.lookup(op1));
         }
-        // Phi function
-        else if(const PHINode* p = dyn_cast<PHINode>(I)) {
-          std::unordered_set<StrictRelations::Variable*> vset;
-          for(int i = 0, e = p->getNumIncomingValues(); i < e; i++) {
-            const Value* op = p->getIncomingValue(i);
-            if(!variables.count(op)) variables[op] =
-                                          new StrictRelations::Variable(op);
-            vset.insert(variables.at(op));
-          }
-          Constraint* c = new PHI(wle, variables[I], vset);
+        else if (r2.getLower().sgt(Zero)) {
+          // Case y > 0 then a < x
+            addConstraint<LT>(I, op1);
+        }
+        else if (r2.getLower().sge(Zero)) {
+          // Case y >= 0 then a <= x
+            addConstraint<LE>(I, op1);
+        }
+        else if (r2.getUpper().slt(Zero)) {
+          // Case y < 0 then x < a
+            addConstraint<LT>(op1, I);
+        }
+        else if (r2.getUpper().sle(Zero)) {
+          // Case y <= 0 then x <= a
+            addConstraint<LE>(op1, I);
+        }
+      }
+      // GEP Instruction
+      else if (const GetElementPtrInst* p = dyn_cast<GetElementPtrInst>(I)) {
+        // Getting base pointer
+        const Value* base = p->getPointerOperand();
+        // Geting bit range of offset
+        Range r = processGEP (base, p->idx_begin(), p->idx_end());
+        if(r.getLower().eq(Zero) and r.getUpper().eq(Zero)) {
+          // Case p = b + 0 then p = b
+          addConstraint<REQ>(I, base);
+          variables.coalesce(variables.lookup(I), variables.lookup(base));
+        }
+        else if (r.getLower().sgt(Zero)) {
+          // Case p = b + (>0) then b < p
+          addConstraint<LT>(base, I);
+        }
+        else if (r.getLower().sge(Zero)) {
+          // Case p = b + (>=0) then b <= p
+          addConstraint<LE>(base, I);
+        }
+        else if (r.getUpper().slt(Zero)) {
+          // Case p = b + (<0) then p < b
+          addConstraint<LT>(I, base);
+        }
+        else if (r.getUpper().sle(Zero)) {
+          // Case p = b + (<=0) then p <= b
+          addConstraint<LE>(I, base);
+        }
+      }
+      // Sigma
+      else if(isa<PHINode>(&(*I)) && (I->getNumOperands() == 1) ) {
+        const PHINode* p = dyn_cast<PHINode>(I);
+        
+        const BasicBlock* cmpBB = p->getIncomingBlock(0);
+
+        if(!isa<BranchInst>(cmpBB->getTerminator())) {
+          errs() << "Error on evaluating sigma!\n";
+          continue;
+        }
+        const BranchInst* br = dyn_cast<BranchInst>(cmpBB->getTerminator());
+        // Getting weather true or false sigma 
+        const BasicBlock* curBB = I->getParent();
+        bool trueSigma = curBB == br->getSuccessor(0);
+
+        if(!br->isConditional()) {
+          errs() << "Error on evaluating sigma!\n";
+          continue;
+        } 
+        const Value* cmpV = br->getCondition();
 
-          NumConstraints++;
-          variables[I]->constraints.insert(c);
-          for(auto i : vset)
-            i->constraints.insert(c);
-          wle->add(c);
+        if (!isa<CmpInst>(cmpV)){
+          errs() << "Error on evaluating sigma!\n";
+          continue;
         }
-        // Bitcasts and such
-        else if(isa<BitCastInst>(&(*I))
-        || isa<SExtInst>(&(*I))
-        || isa<ZExtInst>(&(*I))) {
-          const Value* op = I->getOperand(0);
-          if(!variables.count(op)) variables[op] =
-                                          new StrictRelations::Variable(op);
-          Constraint* c = new REQ(wle, variables[I], variables[op]);
-          variables[I]->coalesce(variables[op]);
-
-          NumConstraints++;
-          variables[I]->constraints.insert(c);
-          variables[op]->constraints.insert(c);
-          wle->add(c);
+        // Getting comparison instruction
+        const CmpInst* cmpInst = dyn_cast<CmpInst>(cmpV);
+        // Getting side of predicate
+        bool leftSide = p->getIncomingValue(0) == cmpInst->getOperand(0);
+        // Adding to sigmas structures
+        if(leftSide and trueSigma)
+          sigmas[cmpInst].first.first = p;
+        else if(leftSide and !trueSigma)
+          sigmas[cmpInst].first.second = p;
+        else if(!leftSide and trueSigma)
+          sigmas[cmpInst].second.first = p;
+        else if(!leftSide and !trueSigma)
+          sigmas[cmpInst].second.second = p;
+
+        // Adding eq constraint
+        const Value* op = p->getIncomingValue(0);
+        addConstraint<EQ>(I, op);
+      }
+      // Phi function
+      else if(const PHINode* p = dyn_cast<PHINode>(I)) {
+        SmallVector<VarId, 4> vset;
+        for(int i = 0, e = p->getNumIncomingValues(); i < e; i++) {
+          VarId op = variables.getOrInsert(p->getIncomingValue(i));
+          if(std::find(vset.begin(), vset.end(), op) == vset.end())
+            vset.push_back(op);
         }
+        VarId left = variables.lookup(I);
+        Constraint* c = constraintArena->create<PHI>(wle, left, vset);
+
+        NumConstraints++;
+        variables.addConstraint(left, c);
+        for(auto i : vset)
+          variables.addConstraint(i, c);
+        wle->add(c);
+      }
+      // Bitcasts and such
+      else if(isa<BitCastInst>(&(*I))
+      || isa<SExtInst>(&(*I))
+      || isa<ZExtInst>(&(*I))) {
+        const Value* op = I->getOperand(0);
+        addConstraint<REQ>(I, op);
+        variables.coalesce(variables.lookup(I), variables.lookup(op));
       }
     }
   }
@@ -1079,31 +1449,20 @@ void StrictRelations::collectConstraintsFromModule(Module &M) {
     if (i.second.second.second == NULL and i.second.first.second != NULL)
       i.second.second.second = i.first->getOperand(1);*/
     
-    Constraint* c;
     if(pred == CmpInst::ICMP_UGT or pred == CmpInst::ICMP_SGT) {
       if(i.second.second.first != NULL and
          i.second.first.first != NULL and
          variables.count(i.second.second.first) and
          variables.count(i.second.first.first)) {
-        c = new LT(wle, variables[i.second.second.first],
-                                    variables[i.second.first.first]);
-
-        NumConstraints++;
-        variables[i.second.second.first]->constraints.insert(c);
-        variables[i.second.first.first]->constraints.insert(c);
-        wle->add(c);
+        addConstraint<LT>(i.second.second.first,
+                          i.second.first.first);
       }
       if(i.second.first.second != NULL and
          i.second.second.second != NULL and
          variables.count(i.second.first.second) and
          variables.count(i.second.second.second)) {
-        c = new LE(wle, variables[i.second.first.second],
-                        variables[i.second.second.second]);
-
-        NumConstraints++;
-        variables[i.second.first.second]->constraints.insert(c);
-        variables[i.second.second.second]->constraints.insert(c);
-        wle->add(c);
+        addConstraint<LE>(i.second.first.second,
+                          i.second.second.second);
       }
     }
     else if(pred == CmpInst::ICMP_UGE or pred == CmpInst::ICMP_SGE) {
@@ -1111,25 +1470,15 @@ void StrictRelations::collectConstraintsFromModule(Module &M) {
          i.second.first.first != NULL and
          variables.count(i.second.second.first) and
          variables.count(i.second.first.first)) {
-        c = new LE(wle, variables[i.second.second.first],
-                                    variables[i.second.first.first]);
-
-        NumConstraints++;
-        variables[i.second.second.first]->constraints.insert(c);
-        variables[i.second.first.first]->constraints.insert(c);
-        wle->add(c);
+        addConstraint<LE>(i.second.second.first,
+                          i.second.first.first);
       }
       if(i.second.first.second != NULL and
          i.second.second.second != NULL and
          variables.count(i.second.first.second) and
          variables.count(i.second.second.second)) {
-        c = new LT(wle, variables[i.second.first.second],
-                        variables[i.second.second.second]);
-
-        NumConstraints++;
-        variables[i.second.first.second]->constraints.insert(c);
-        variables[i.second.second.second]->constraints.insert(c);
-        wle->add(c);
+        addConstraint<LT>(i.second.first.second,
+                          i.second.second.second);
       }
     }
     else if(pred == CmpInst::ICMP_ULT or pred == CmpInst::ICMP_SLT) {
@@ -1137,25 +1486,15 @@ void StrictRelations::collectConstraintsFromModule(Module &M) {
          i.second.second.first != NULL and
          variables.count(i.second.first.first) and
          variables.count(i.second.second.first)) {
-        c = new LT(wle, variables[i.second.first.first],
-                                    variables[i.second.second.first]);
-      
-        NumConstraints++;
-        variables[i.second.first.first]->constraints.insert(c);
-        variables[i.second.second.first]->constraints.insert(c);
-        wle->add(c);
+        addConstraint<LT>(i.second.first.first,
+                          i.second.second.first);
       }
       if(i.second.second.second != NULL and
          i.second.first.second != NULL and
          variables.count(i.second.second.second) and
          variables.count(i.second.first.second)) {
-        c = new LE(wle, variables[i.second.second.second],
-                        variables[i.second.first.second]);
-
-        NumConstraints++;
-        variables[i.second.second.second]->constraints.insert(c);
-        variables[i.second.first.second]->constraints.insert(c);
-        wle->add(c);
+        addConstraint<LE>(i.second.second.second,
+                          i.second.first.second);
       }
     }
     else if(pred == CmpInst::ICMP_ULE or pred == CmpInst::ICMP_SLE) {
@@ -1163,25 +1502,15 @@ void StrictRelations::collectConstraintsFromModule(Module &M) {
          i.second.second.first != NULL and
          variables.count(i.second.first.first) and
          variables.count(i.second.second.first)) {
-        c = new LE(wle, variables[i.second.first.first],
-                                    variables[i.second.second.first]);
-
-        NumConstraints++;
-        variables[i.second.first.first]->constraints.insert(c);
-        variables[i.second.second.first]->constraints.insert(c);
-        wle->add(c);
+        addConstraint<LE>(i.second.first.first,
+                          i.second.second.first);
       }
       if(i.second.second.second != NULL and
          i.second.first.second != NULL and
          variables.count(i.second.second.second) and
          variables.count(i.second.first.second)) {
-        c = new LT(wle, variables[i.second.second.second],
-                        variables[i.second.first.second]);
-
-        NumConstraints++;
-        variables[i.second.second.second]->constraints.insert(c);
-        variables[i.second.first.second]->constraints.insert(c);
-        wle->add(c);
+        addConstraint<LT>(i.second.second.second,
+                          i.second.first.second);
       }
     }
     else if(pred == CmpInst::ICMP_EQ) {
@@ -1189,14 +1518,10 @@ void StrictRelations::collectConstraintsFromModule(Module &M) {
          i.second.second.first != NULL and
          variables.count(i.second.first.first) and
          variables.count(i.second.second.first)) {
-        c = new REQ(wle, variables[i.second.first.first],
-                                    variables[i.second.second.first]);
-        variables[i.second.first.first]->coalesce(variables[i.second.second.first]);
-
-        NumConstraints++;
-        variables[i.second.first.first]->constraints.insert(c);
-        variables[i.second.second.first]->constraints.insert(c);
-        wle->add(c);
+        addConstraint<REQ>(i.second.first.first,
+                           i.second.second.first);
+        variables.coalesce(variables.lookup(i.second.first.first),
+                           variables.lookup(i.second.second.first));
       }
     }
     else if(pred == CmpInst::ICMP_NE) {
@@ -1204,187 +1529,232 @@ void StrictRelations::collectConstraintsFromModule(Module &M) {
          i.second.second.second != NULL and
          variables.count(i.second.first.second) and
          variables.count(i.second.second.second)) {
-        c = new REQ(wle, variables[i.second.first.second],
-                                    variables[i.second.second.second]);
-        variables[i.second.first.second]->coalesce(variables[i.second.second.second]);
-
-        NumConstraints++;
-        variables[i.second.first.second]->constraints.insert(c);
-        variables[i.second.second.second]->constraints.insert(c);
-        wle->add(c);
+        addConstraint<REQ>(i.second.first.second,
+                           i.second.second.second);
+        variables.coalesce(variables.lookup(i.second.first.second),
+                           variables.lookup(i.second.second.second));
       }
     }
   }
+  
+  FunctionInfo &Info = functions[&F];
+  for(VarId v = firstVar, e = variables.size(); v != e; ++v)
+    if(getFunctionOf(variables.getValue(v)) == &F) Info.vars.push_back(v);
+  const std::vector<const Constraint*> &C = wle->getConstraints();
+  Info.constraints.insert(Info.constraints.end(),
+                          C.begin() + firstConstraint, C.end());
+}
+
+StrictRelations::DepEdge*
+StrictRelations::DepNode::addEdge(AnalysisArena &A, DepNode* in,
+                                  DepNode* out, Range r, const Value* o) {
+  DepEdge* e = A.create<DepEdge>(in, out, r, o);
+  in->inedges.push_back(e);
+  out->outedges.push_back(e);
+  return e;
+}
+
+StrictRelations::DepNode* StrictRelations::newNode(const Value* V) {
+  DepNode* n = arena->create<DepNode>(V, nodeClasses.add());
+  if(const Function* F = getFunctionOf(V)) functions[F].nodes.push_back(n);
+  return n;
+}
+
+StrictRelations::DepNode* StrictRelations::getOrCreateNode(const Value* V) {
+  DepNode* &n = nodes[V];
+  if(!n) n = newNode(V);
+  return n;
+}
+
+void StrictRelations::joinNodes(DepNode* A, DepNode* B) {
+  nodeClasses.join(A->id, B->id);
+  nodeJoins.push_back(std::make_pair(A, B));
 }
 
-void StrictRelations::DepNode::coalesce (StrictRelations::DepNode* other){
-  if(mustalias == other->mustalias) return;
-  std::unordered_set<DepNode*>* to_coalesce = other->mustalias;
-  for(auto i : *to_coalesce) i->mustalias = mustalias;
-  mustalias->insert(to_coalesce->begin(), to_coalesce->end());
-  delete to_coalesce;           
+// Adds the pointers of F, and the pointers F uses, to Pointers
+static void collectPointers(Function &F, std::set<const Value*> &Pointers) {
+  /// Go through parameters (add if they are pointers)
+  for(auto i = F.arg_begin(), e = F.arg_end(); i != e; i++) {
+    Type* const arg_type = i->getType();
+    if(arg_type->isPointerTy()) {
+      Pointers.insert(i);
+    }
+  }
+  /// Run through instructions from function
+  for (inst_iterator I = inst_begin(F), E = inst_end(F); I != E; ++I) {
+    const Instruction* i = &(*I);
+    const Type *type = i->getType();
+    if(type->isPointerTy()){
+      Pointers.insert(i);
+    }
+    ///verify intruction operands
+    for(auto oi = i->op_begin(), oe = i->op_end(); oi != oe; oi++) {
+      const Value* oper = *oi;
+      const Type *op_type = oper->getType();
+      if(op_type->isPointerTy()){
+        Pointers.insert(oper);
+      } 
+    }
+  }
 }
 
 void StrictRelations::buildDepGraph(Module &M){
   std::set<const Value*> pointers;
-  /// Go through global variables to find arrays, structs and pointers
-  for(auto i = M.global_begin(), e = M.global_end(); i != e; i++) {
-    //Since all globals are pointers, all are inserted
-    pointers.insert(i);
-  }
-  /// Go through all functions from the module
-  for (auto F = M.begin(), Fe = M.end(); F != Fe; F++) {
-    /// Go through parameters (add if they are pointers)
-    for(auto i = F->arg_begin(), e = F->arg_end(); i != e; i++) {
-      Type* const arg_type = i->getType();
-      if(arg_type->isPointerTy()) {
-        pointers.insert(i);
-      }
-    }
-     /// Run through instructions from function
-    for (inst_iterator I = inst_begin(F), E = inst_end(F); I != E; ++I) {
-      const Instruction* i = &(*I);
-      const Type *type = i->getType();
-      if(type->isPointerTy()){
-        pointers.insert(i);
-      }
-      ///verify intruction operands
-      for(auto oi = i->op_begin(), oe = i->op_end(); oi != oe; oi++) {
-        const Value* oper = *oi;
-        const Type *op_type = oper->getType();
-        if(op_type->isPointerTy()){
-		  pointers.insert(oper);
-		} 
-      }
+  if(scope) {
+    // Only the globals the function uses
+    collectPointers(*scope, pointers);
+  } else {
+    /// Go through global variables to find arrays, structs and pointers
+    for(auto i = M.global_begin(), e = M.global_end(); i != e; i++) {
+      //Since all globals are pointers, all are inserted
+      pointers.insert(i);
     }
+    /// Go through all functions from the module
+    for (auto F = M.begin(), Fe = M.end(); F != Fe; F++)
+      collectPointers(*F, pointers);
   }
   
   NumNodes = pointers.size();
   for(auto i : pointers){
-    nodes[i] = new DepNode(i);
+    nodes[i] = newNode(i);
   }
   
-  //Finding edges
-  for(auto i : nodes) {
-    if(const Argument* p = dyn_cast<Argument>(i.first)) {
-      const Function* F = p->getParent();
-      //Go through all the uses of the argument's function, the calls are
-      // the addresses bases
-      for(auto ui = F->user_begin(), ue = F->user_end(); ui != ue; ui++) {
-        const User* u = *ui;
-        if(const CallInst* caller = dyn_cast<CallInst>(u)) {
-          int anum = caller->getNumArgOperands();
-          int ano = p->getArgNo();
-          if(ano <= anum) {
-            const Value* base = caller->getArgOperand(ano);
-            if(!nodes.count(base)) nodes[base] = new DepNode(base);
-            DepNode::addEdge(i.second, nodes[base], Range(Zero,Zero));
-            NumEdges++;
-          } else {
-            /// TODO: support standard values in cases where the argument
-            /// has a standard value and does not appear in function call
-            DEBUG_WITH_TYPE("errors",
-              errs() << "!: ERROR (Not enough arguments):\n");
-            DEBUG_WITH_TYPE("errors", errs() << *p << " " << ano << "\n");
-            DEBUG_WITH_TYPE("errors", errs() << *u << "\n");
-            i.second->unk = true;
-            std::set<DepEdge*> to_remove;
-            for(auto e : i.second->inedges) to_remove.insert(e);
-            for(auto e : to_remove) DepEdge::deleteEdge(e);
-           return;
-          }
-        }
-      }	
-	  }
-    else if(const CallInst* p = dyn_cast<CallInst>(i.first)) {
-	    Function* CF = p->getCalledFunction();
-      if(CF) {
-        if(strcmp( CF->getName().data(), "realloc") == 0)
-        {
-          /// realloc is connected with it's first argument
-          const Value* base = p->getOperand(0);
-          if(!nodes.count(base)) nodes[base] = new DepNode(base);
-          DepNode::addEdge(i.second, nodes[base], Range(Zero,Zero));
-          NumEdges++;
-        } else {
-          for (auto j = inst_begin(CF), e = inst_end(CF); j != e; j++)
-            if(isa<const ReturnInst>(*j)) {
-              /// create edge
-              const Value* ret_ptr = ((ReturnInst*)&(*j))->getReturnValue();
-              if(!nodes.count(ret_ptr)) nodes[ret_ptr] = new DepNode(ret_ptr);
-              DepNode::addEdge(i.second, nodes[ret_ptr], Range(Zero,Zero));
-              NumEdges++;
-            }
-        }
-      }
-	  } 
-    else if(const GetElementPtrInst* p = dyn_cast<GetElementPtrInst>(i.first)) {
-	    // Getting base pointer
-      const Value* base = p->getPointerOperand();
-      // Geting bit range of offset
-      Range r = processGEP (base, p->idx_begin(), p->idx_end());
-      
-      if(!nodes.count(base)) nodes[base] = new DepNode(base);
-      if(r == Range(Zero, Zero)) nodes[base]->coalesce(i.second);
-      DepNode::addEdge(i.second, nodes[base], r);
-      NumEdges++;
-	  }
-    else if(const BitCastInst* p = dyn_cast<BitCastInst>(i.first)) {
-	    const Value* base = p->getOperand(0);
-      if(!nodes.count(base)) nodes[base] = new DepNode(base);
-      nodes[base]->coalesce(i.second);
-      DepNode::addEdge(i.second, nodes[base], Range(Zero,Zero));
-      NumEdges++;
-	  }
-    else if(const SExtInst* p = dyn_cast<SExtInst>(i.first)) {
-	    const Value* base = p->getOperand(0);
-      if(!nodes.count(base)) nodes[base] = new DepNode(base);
-      nodes[base]->coalesce(i.second);
-      DepNode::addEdge(i.second, nodes[base], Range(Zero,Zero));
-      NumEdges++;
-	  }
-    else if(const ZExtInst* p = dyn_cast<ZExtInst>(i.first)) {
-	    const Value* base = p->getOperand(0);
-      if(!nodes.count(base)) nodes[base] = new DepNode(base);
-      nodes[base]->coalesce(i.second);
-      DepNode::addEdge(i.second, nodes[base], Range(Zero,Zero));
-      NumEdges++;
-	  }
-    else if(const PHINode* p = dyn_cast<PHINode>(i.first)) {
-	    for(unsigned int j = 0; j < p->getNumIncomingValues(); j++){
-	      const Value* base = p->getIncomingValue(j);
-	      if(!nodes.count(base)) nodes[base] = new DepNode(base);
-        DepNode::addEdge(i.second, nodes[base], Range(Zero,Zero));
-        NumEdges++;
-	    }
-	  }
-    else if(const GEPOperator* p = dyn_cast<GEPOperator>(i.first)) {
-	    // Getting base pointer
-      const Value* base = p->getPointerOperand();
-      // Geting bit range of offset
-      Range r = processGEP (base, p->idx_begin(), p->idx_end());
-      
-      if(!nodes.count(base)) nodes[base] = new DepNode(base);
-      DepNode::addEdge(i.second, nodes[base], r);
+  //Finding edges. Edges may add nodes, so the nodes are listed first.
+  std::vector<DepNode*> list;
+  for(auto i : nodes) list.push_back(i.second);
+  partialGraph = false;
+  for(auto n : list)
+    if(!addEdges(n)) {
+      partialGraph = true;
+      return;
+    }
+}
+
+// The argument is connected with the actual parameter of the call. The edge
+// comes from the code of the caller.
+bool StrictRelations::addArgumentEdge(DepNode* n, const Argument* p,
+                                      const CallInst* caller) {
+  int anum = caller->getNumArgOperands();
+  int ano = p->getArgNo();
+  if(ano <= anum) {
+    const Value* base = caller->getArgOperand(ano);
+    DepEdge* e = DepNode::addEdge(*arena, n, getOrCreateNode(base),
+                                  Range(Zero,Zero));
+    NumEdges++;
+    const Function* From = caller->getParent()->getParent();
+    if(From != p->getParent()) functions[From].edges.push_back(e);
+    return true;
+  }
+  /// TODO: support standard values in cases where the argument
+  /// has a standard value and does not appear in function call
+  DEBUG_WITH_TYPE("errors",
+    errs() << "!: ERROR (Not enough arguments):\n");
+  DEBUG_WITH_TYPE("errors", errs() << *p << " " << ano << "\n");
+  DEBUG_WITH_TYPE("errors", errs() << *caller << "\n");
+  n->unk = true;
+  n->missingArg = true;
+  std::set<DepEdge*> to_remove;
+  for(auto e : n->inedges) to_remove.insert(e);
+  for(auto e : to_remove) DepEdge::deleteEdge(e);
+  return false;
+}
+
+// The call is connected with the values returned by the called function.
+// The edges come from the code of the called function.
+void StrictRelations::addCallEdges(DepNode* n, const CallInst* p) {
+  Function* CF = p->getCalledFunction();
+  if(!CF) return;
+  if(strcmp( CF->getName().data(), "realloc") == 0)
+  {
+    /// realloc is connected with it's first argument
+    const Value* base = p->getOperand(0);
+    DepNode::addEdge(*arena, n, getOrCreateNode(base), Range(Zero,Zero));
+    NumEdges++;
+    return;
+  }
+  // Within a single function, calls are roots
+  if(scope) return;
+  const Function* From = p->getParent()->getParent();
+  for (auto j = inst_begin(CF), e = inst_end(CF); j != e; j++)
+    if(isa<const ReturnInst>(*j)) {
+      /// create edge
+      const Value* ret_ptr = ((ReturnInst*)&(*j))->getReturnValue();
+      DepEdge* edge = DepNode::addEdge(*arena, n, getOrCreateNode(ret_ptr),
+                                       Range(Zero,Zero));
       NumEdges++;
-	  }
-    else if(const ConstantExpr* p = dyn_cast<ConstantExpr>(i.first)) {
-	  const char* operation = p->getOpcodeName();
-      if(strcmp(operation, "bitcast") == 0) {
-        const Value* base = p->getOperand(0);
-        if(!nodes.count(base)) nodes[base] = new DepNode(base);
-        nodes[base]->coalesce(i.second);
-        DepNode::addEdge(i.second, nodes[base], Range(Zero,Zero));
-        NumEdges++;
-      }
-	  }
+      if(CF != From) functions[CF].edges.push_back(edge);
+    }
+}
+
+bool StrictRelations::addEdges(DepNode* n) {
+  const Value* v = n->v;
+  if(const Argument* p = dyn_cast<Argument>(v)) {
+    // Within a single function, arguments are roots
+    if(scope) return true;
+    const Function* F = p->getParent();
+    //Go through all the uses of the argument's function, the calls are
+    // the addresses bases
+    for(auto ui = F->user_begin(), ue = F->user_end(); ui != ue; ui++) {
+      if(const CallInst* caller = dyn_cast<CallInst>(*ui))
+        if(!addArgumentEdge(n, p, caller)) return false;
+    }
+  }
+  else if(const CallInst* p = dyn_cast<CallInst>(v)) {
+    addCallEdges(n, p);
+  } 
+  else if(const GetElementPtrInst* p = dyn_cast<GetElementPtrInst>(v)) {
+    // Getting base pointer
+    const Value* base = p->getPointerOperand();
+    // Geting bit range of offset
+    Range r = processGEP (base, p->idx_begin(), p->idx_end());
     
+    DepNode* b = getOrCreateNode(base);
+    if(r == Range(Zero, Zero))
+      joinNodes(b, n);
+    DepNode::addEdge(*arena, n, b, r);
+    NumEdges++;
+  }
+  else if(isa<BitCastInst>(v) or isa<SExtInst>(v) or isa<ZExtInst>(v)) {
+    DepNode* b = getOrCreateNode(cast<Instruction>(v)->getOperand(0));
+    joinNodes(b, n);
+    DepNode::addEdge(*arena, n, b, Range(Zero,Zero));
+    NumEdges++;
+  }
+  else if(const PHINode* p = dyn_cast<PHINode>(v)) {
+    for(unsigned int j = 0; j < p->getNumIncomingValues(); j++){
+      const Value* base = p->getIncomingValue(j);
+      DepNode::addEdge(*arena, n, getOrCreateNode(base), Range(Zero,Zero));
+      NumEdges++;
+    }
   }
+  else if(const GEPOperator* p = dyn_cast<GEPOperator>(v)) {
+    // Getting base pointer
+    const Value* base = p->getPointerOperand();
+    // Geting bit range of offset
+    Range r = processGEP (base, p->idx_begin(), p->idx_end());
     
+    DepNode::addEdge(*arena, n, getOrCreateNode(base), r);
+    NumEdges++;
+  }
+  else if(const ConstantExpr* p = dyn_cast<ConstantExpr>(v)) {
+    const char* operation = p->getOpcodeName();
+    if(strcmp(operation, "bitcast") == 0) {
+      DepNode* b = getOrCreateNode(p->getOperand(0));
+      joinNodes(b, n);
+      DepNode::addEdge(*arena, n, b, Range(Zero,Zero));
+      NumEdges++;
+    }
+  }
+  return true;
 }
 
 void StrictRelations::collectTypes() {
   for(auto i : nodes) {
+    // Types are found from scratch, also after an update
+    i.second->arg = false; i.second->unk = i.second->missingArg;
+    i.second->global = false;
+    i.second->call = false; i.second->alloca = false;
+    i.second->locs.clear();
     if(isa<const Argument>(*(i.first))) {
       i.second->arg = true;
     }
@@ -1424,146 +1794,775 @@ void StrictRelations::collectTypes() {
 }
 
 void StrictRelations::propagateTypes(){
-  std::set<DepNode*> args;
-  std::set<DepNode*> globals;
-  std::set<DepNode*> unks;
-  std::set<DepNode*> allocas;
-  for(auto i : nodes){
-    if(i.second->arg){ args.insert(i.second); }
-    if(i.second->global){ globals.insert(i.second); }
-    if(i.second->unk){ unks.insert(i.second); }
-    if(i.second->alloca){ allocas.insert(i.second); }
-  }
-  std::queue<DepNode*>to_visit;
-  std::unordered_set<DepNode*>visited;
-  //Propagating args
-  propagateArgs(args);
-  //Propagating globals
-  propagateGlobals(globals);
-  //Propagating unks
-  propagateUnks(unks); 
-  //Propagating allocas
-  for(auto i : allocas) {
-    propagateAlloca(i);
-  }
-}
-
-void StrictRelations::propagateArgs(std::set<DepNode*> &args) {
-  std::queue<DepNode*>to_visit;
-  std::unordered_set<DepNode*>visited;
-  
-  for(auto i : args) to_visit.push(i);
+  // Nodes are numbered, and ranked by the topological order of the strongly
+  // connected components of the graph along the out-edges
+  std::vector<DepNode*> order;
+  DenseMap<DepNode*, unsigned> index;
+  for(auto i : nodes) {
+    index[i.second] = order.size();
+    order.push_back(i.second);
+  }
+  std::vector< SmallVector<unsigned, 4> > succs(order.size());
+  for(unsigned n = 0, e = order.size(); n != e; ++n)
+    for(auto i : order[n]->outedges)
+      succs[n].push_back(index.lookup(i->in));
+  std::vector<unsigned> component;
+  unsigned numComponents = findComponents(succs, component);
+  
+  // Seeds: every node with a type, and every allocation site with its own
+  // location
+  RankedWorkList<unsigned> to_visit;
+  to_visit.setNumRanks(numComponents);
+  std::vector<bool> queued(order.size(), false);
+  allocSites.clear();
+  for(unsigned n = 0, e = order.size(); n != e; ++n) {
+    DepNode* current = order[n];
+    if(current->alloca) {
+      current->locs.set(allocSites.size());
+      allocSites.push_back(current->v);
+    }
+    if(current->arg or current->global or current->unk or current->alloca) {
+      to_visit.push(n, numComponents - 1 - component[n]);
+      queued[n] = true;
+    }
+  }
+  
+  // Types and locations flow together along the out-edges, except that
+  // arguments do not flow through calls. Components are visited in
+  // topological order, so outside cycles every node is visited once.
   while(!(to_visit.empty())){
-    DepNode* current = to_visit.front();
-    to_visit.pop();
-    visited.insert(current);
-    if(!(current->call)){
-      current->arg = true;
-      for(auto i : current->outedges){
-        if(!(visited.count(i->in))){
-         to_visit.push(i->in);
-        }
+    unsigned n = to_visit.pop();
+    queued[n] = false;
+    DepNode* current = order[n];
+    
+    for(auto i : current->outedges){
+      DepNode* next = i->in;
+      bool changed = false;
+      if(current->arg and !next->arg and !next->call) {
+        next->arg = true;
+        changed = true;
+      }
+      if(current->global and !next->global) {
+        next->global = true;
+        changed = true;
+      }
+      if(current->unk and !next->unk) {
+        next->unk = true;
+        changed = true;
+      }
+      if(next->locs |= current->locs) changed = true;
+      
+      unsigned m = index.lookup(next);
+      if(changed and !queued[m]) {
+        to_visit.push(m, numComponents - 1 - component[m]);
+        queued[m] = true;
       }
     }
   }
 }
 
-void StrictRelations::propagateGlobals(std::set<DepNode*> &globals) {
-  std::queue<DepNode*>to_visit;
-  std::unordered_set<DepNode*>visited;
+StrictRelations::PathSum::PathSum() : lowerInf(0), upperInf(0) {
+  unsigned width = Min.getBitWidth() + 32;
+  lower = upper = mag = APInt(width, 0);
+}
+
+StrictRelations::PathSum::PathSum(const Range &R) {
+  *this = PathSum();
+  unsigned width = lower.getBitWidth();
+  if(R.isUnknown()) {
+    lowerInf = upperInf = 1;
+    return;
+  }
+  if(R.getLower().eq(Min)) lowerInf = 1;
+  else {
+    lower = R.getLower().sext(width);
+    mag += lower.abs();
+  }
+  if(R.getUpper().eq(Max)) upperInf = 1;
+  else {
+    upper = R.getUpper().sext(width);
+    mag += upper.abs();
+  }
+}
+
+StrictRelations::PathSum
+StrictRelations::PathSum::operator+(const PathSum &Other) const {
+  PathSum s(*this);
+  s.lower += Other.lower;
+  s.upper += Other.upper;
+  s.mag += Other.mag;
+  s.lowerInf += Other.lowerInf;
+  s.upperInf += Other.upperInf;
+  return s;
+}
+
+StrictRelations::PathSum
+StrictRelations::PathSum::operator-(const PathSum &Other) const {
+  PathSum s(*this);
+  s.lower -= Other.lower;
+  s.upper -= Other.upper;
+  s.mag -= Other.mag;
+  s.lowerInf -= Other.lowerInf;
+  s.upperInf -= Other.upperInf;
+  return s;
+}
+
+bool StrictRelations::PathSum::getRange(Range &R) const {
+  unsigned width = Min.getBitWidth();
+  if(mag.sge(Max.sext(mag.getBitWidth()))) return false;
+  R = Range(lowerInf ? Min : lower.trunc(width),
+            upperInf ? Max : upper.trunc(width));
+  return true;
+}
+
+void StrictRelations::buildForest() {
+  for(auto i : nodes) {
+    DepNode* n = i.second;
+    n->up = n->inedges.size() == 1 ? *(n->inedges.begin()) : NULL;
+    n->top = NULL;
+  }
   
-  for(auto i : globals) to_visit.push(i);
-  while(!(to_visit.empty())){
-    DepNode* current = to_visit.front();
-    to_visit.pop();
-    current->global = true;
-    visited.insert(current);
+  // Cycles: walk up from every node until reaching a root, a node seen in a
+  // previous walk, or a node of this walk, which closes a cycle
+  DenseMap<DepNode*, unsigned> walk;
+  unsigned numWalks = 0;
+  std::vector<DepNode*> path;
+  for(auto i : nodes) {
+    DepNode* n = i.second;
+    unsigned w = ++numWalks;
+    path.clear();
+    while(n and !walk.count(n)) {
+      walk[n] = w;
+      path.push_back(n);
+      n = n->up ? n->up->out : NULL;
+    }
+    if(n == NULL or walk[n] != w) continue;
     
-    for(auto i : current->outedges){
-      if(!(visited.count(i->in))){
-	     to_visit.push(i->in);
-	    }
+    // Every cycle node is a top; the local root of the whole component is
+    // the node with the highest address
+    auto b = std::find(path.begin(), path.end(), n);
+    DepNode* root = NULL;
+    for(auto c = b; c != path.end(); ++c)
+      if(root < *c) root = *c;
+    PathSum s;
+    unsigned pos = 0;
+    for(auto c = b; c != path.end(); ++c) {
+      DepNode* m = *c;
+      m->top = m;
+      m->jump = m;
+      m->depth = 0;
+      m->sum = PathSum();
+      m->local_root = root;
+      m->cyclePos = pos++;
+      m->cycleSum = s;
+      s = s + PathSum(m->up->range);
+    }
+    for(auto c = b; c != path.end(); ++c) (*c)->cycleTotal = s;
+  }
+  
+  // Trees: walk up to a node already placed, then place the walked nodes
+  // from the top down
+  for(auto i : nodes) {
+    DepNode* n = i.second;
+    path.clear();
+    while(n->top == NULL and n->up) {
+      path.push_back(n);
+      n = n->up->out;
+    }
+    if(n->top == NULL) {
+      n->top = n;
+      n->jump = n;
+      n->depth = 0;
+      n->local_root = n;
+    }
+    for(auto c = path.rbegin(), e = path.rend(); c != e; ++c) {
+      DepNode* m = *c;
+      DepNode* p = m->up->out;
+      m->top = p->top;
+      m->depth = p->depth + 1;
+      m->sum = PathSum(m->up->range) + p->sum;
+      DepNode* j = p->jump;
+      if(p->depth - j->depth == j->depth - j->jump->depth) m->jump = j->jump;
+      else m->jump = p;
+      // Hanging from a cycle, the path of m also holds the whole cycle
+      if(m->top->up == NULL) m->local_root = p->local_root;
+      else m->local_root = std::max(m, p->local_root);
+    }
+  }
+}
+
+// Lowest common ancestor of two nodes of the same tree
+StrictRelations::DepNode* 
+StrictRelations::getCommonAncestor(DepNode* u, DepNode* v) {
+  while(u->depth > v->depth)
+    u = u->jump->depth >= v->depth ? u->jump : u->up->out;
+  while(v->depth > u->depth)
+    v = v->jump->depth >= u->depth ? v->jump : v->up->out;
+  // Nodes of the same depth have jumps of the same depth
+  while(u != v) {
+    if(u->jump != v->jump) {
+      u = u->jump;
+      v = v->jump;
+    } else {
+      u = u->up->out;
+      v = v->up->out;
     }
   }
+  return u;
 }
 
-void StrictRelations::propagateUnks(std::set<DepNode*> &unks) {
-  std::queue<DepNode*>to_visit;
-  std::unordered_set<DepNode*>visited;
+////////////////////////////////////////////////////////////////////////////////
+// FunctionStrictRelations definitions
+
+void FunctionStrictRelations::getAnalysisUsage(AnalysisUsage &AU) const {
+  AliasAnalysis::getAnalysisUsage(AU);
+  AU.addRequired<IntraProceduralRA<Cousot> >();
+  AU.setPreservesAll();
+}
+
+bool FunctionStrictRelations::runOnFunction(Function &F) {
+  InitializeAliasAnalysis(this, &F.getParent()->getDataLayout());
+  releaseAnalysis();
+  SR.reset(new StrictRelations(false));
+  SR->analyze(*F.getParent(), getAnalysis<IntraProceduralRA<Cousot> >(), &F);
+  if(Freeze)
+    SR->freeze();
+  return false;
+}
+
+void FunctionStrictRelations::releaseAnalysis() {
+  if(!SR) return;
+  prof.addPhases(SR->getProfile());
+  SR.reset();
+}
+
+bool FunctionStrictRelations::doFinalization(Module &M) {
+  releaseAnalysis();
+  printTiming(prof);
+  prof.resetPhases();
+  return false;
+}
+
+AliasResult FunctionStrictRelations::alias(const MemoryLocation &LocA,
+                                           const MemoryLocation &LocB) {
+  AliasResult R = SR ? SR->getAliasResult(LocA, LocB) : MayAlias;
+  if(R != MayAlias) return R;
+  return AliasAnalysis::alias(LocA, LocB);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Traces of alias queries
+// A trace has a line per query, with the scope, index and size of each of
+// its two locations, followed by the verdict of the analysis alone. Globals
+// and functions have scope 0 and are numbered in module order; the arguments
+// and instructions of the ith function have scope i + 1 and are numbered in
+// function order. Pointers the module did not have when the trace was opened
+// have scope "-".
+
+// Calls Fn(Scope, Index, V) for every value a trace can name
+template <class F> static void forEachTraceValue(Module &M, F Fn) {
+  unsigned index = 0;
+  for(GlobalVariable &G : M.globals())
+    Fn(0, index++, &G);
+  for(Function &Func : M)
+    Fn(0, index++, &Func);
+  unsigned scope = 1;
+  for(Function &Func : M) {
+    index = 0;
+    for(Argument &A : Func.args())
+      Fn(scope, index++, &A);
+    for(BasicBlock &BB : Func)
+      for(Instruction &I : BB)
+        Fn(scope, index++, &I);
+    scope++;
+  }
+}
+
+void StrictRelations::openTrace(Module &M) {
+  std::error_code EC;
+  trace.reset(new raw_fd_ostream(RecordTrace, EC, sys::fs::F_Text));
+  if(EC) {
+    errs() << "sraa: cannot write " << RecordTrace << ": " << EC.message()
+           << "\n";
+    trace.reset();
+    return;
+  }
+  traceIds.clear();
+  forEachTraceValue(M, [&](unsigned Scope, unsigned Index, const Value* V) {
+    traceIds[V] = std::make_pair(Scope, Index);
+  });
+}
+
+void StrictRelations::recordQuery(const MemoryLocation &LocA,
+                                  const MemoryLocation &LocB, AliasResult R) {
+  static const char *const Verdicts[] = {
+    "NoAlias", "MayAlias", "PartialAlias", "MustAlias"
+  };
+  const MemoryLocation *Locs[2] = { &LocA, &LocB };
+  for(unsigned i = 0; i != 2; ++i) {
+    auto it = traceIds.find(Locs[i]->Ptr);
+    if(i) *trace << ' ';
+    if(it == traceIds.end())
+      *trace << "- 0";
+    else
+      *trace << it->second.first << ' ' << it->second.second;
+    *trace << ' ' << Locs[i]->Size;
+  }
+  *trace << ' ' << Verdicts[R] << '\n';
+}
+
+// Reads the location at Fields[At, At + 3) of a trace line
+static bool parseTraceLocation(ArrayRef<StringRef> Fields, unsigned At,
+                        const std::vector< std::vector<const Value*> > &Values,
+                        MemoryLocation &Loc) {
+  unsigned scope, index;
+  uint64_t size;
+  if(Fields[At].getAsInteger(10, scope) or
+     Fields[At + 1].getAsInteger(10, index) or
+     Fields[At + 2].getAsInteger(10, size))
+    return false;
+  if(scope >= Values.size() or index >= Values[scope].size())
+    return false;
+  Loc = MemoryLocation(Values[scope][index], size);
+  return true;
+}
+
+void AliasTraceReplay::getAnalysisUsage(AnalysisUsage &AU) const {
+  AU.addRequired<AliasAnalysis>();
+  AU.setPreservesAll();
+}
+
+bool AliasTraceReplay::runOnModule(Module &M) {
+  if(ReplayTrace.empty()) {
+    errs() << "sraa-replay: no trace given with -sraa-replay-trace\n";
+    return false;
+  }
+  ErrorOr< std::unique_ptr<MemoryBuffer> > Buffer =
+    MemoryBuffer::getFile(ReplayTrace);
+  if(!Buffer) {
+    errs() << "sraa-replay: cannot read " << ReplayTrace << ": "
+           << Buffer.getError().message() << "\n";
+    return false;
+  }
   
-  for(auto i : unks) to_visit.push(i);
-  while(!(to_visit.empty())){
-    DepNode* current = to_visit.front();
-    to_visit.pop();
-    current->unk = true;
-    visited.insert(current);
-    
-    for(auto i : current->outedges){
-      if(!(visited.count(i->in))){
-	     to_visit.push(i->in);
-	    }
+  std::vector< std::vector<const Value*> > Values;
+  forEachTraceValue(M, [&](unsigned Scope, unsigned Index, const Value* V) {
+    if(Scope >= Values.size()) Values.resize(Scope + 1);
+    Values[Scope].push_back(V);
+  });
+  
+  // Queries are parsed before any is asked, so that only the queries are
+  // timed
+  std::vector< std::pair<MemoryLocation, MemoryLocation> > Queries;
+  unsigned skipped = 0;
+  SmallVector<StringRef, 7> Fields;
+  StringRef Rest = (*Buffer)->getBuffer();
+  while(!Rest.empty()) {
+    StringRef Line;
+    std::tie(Line, Rest) = Rest.split('\n');
+    if(Line.empty()) continue;
+    Fields.clear();
+    Line.split(Fields, " ");
+    MemoryLocation A, B;
+    if(Fields.size() != 7 or !parseTraceLocation(Fields, 0, Values, A) or
+       !parseTraceLocation(Fields, 3, Values, B)) {
+      skipped++;
+      continue;
     }
+    Queries.push_back(std::make_pair(A, B));
   }
+  
+  AliasAnalysis &AA = getAnalysis<AliasAnalysis>();
+  // The tests can only be told apart when the strict relations answer
+  StrictRelations *SR = getAnalysisIfAvailable<StrictRelations>();
+  unsigned noalias[3] = { 0, 0, 0 };
+  for(unsigned t = 0; SR and t != 3; ++t)
+    noalias[t] = SR->getNumNoAlias(t + 1);
+  unsigned results[4] = { 0, 0, 0, 0 };
+  uint64_t start = Profile::ticks();
+  for(auto &Q : Queries)
+    results[AA.alias(Q.first, Q.second)]++;
+  uint64_t ns = Profile::ticks() - start;
+  
+  errs() << "------------------------------------------\n";
+  errs() << "                Replay                    \n";
+  errs() << "------------------------------------------\n";
+  errs() << "Queries: " << Queries.size() << "\n";
+  errs() << "Skipped: " << skipped << "\n";
+  errs() << "Time: " << ns * 1e-9 << "\n";
+  errs() << "Queries per second: "
+         << (ns ? Queries.size() * 1e9 / ns : 0.0) << "\n";
+  errs() << "NoAlias: " << results[NoAlias] << "\n";
+  errs() << "MayAlias: " << results[MayAlias] << "\n";
+  errs() << "PartialAlias: " << results[PartialAlias] << "\n";
+  errs() << "MustAlias: " << results[MustAlias] << "\n";
+  for(unsigned t = 0; SR and t != 3; ++t)
+    errs() << "NoAlias in test " << t + 1 << ": "
+           << SR->getNumNoAlias(t + 1) - noalias[t] << "\n";
+  errs() << "------------------------------------------\n";
+  return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// StrictRelationsAnalysis definitions
+
+char StrictRelationsAnalysis::PassID;
+
+StrictRelationsAnalysis::Result
+StrictRelationsAnalysis::run(Module &M, ModuleAnalysisManager *AM) {
+  InterProceduralRAAnalysis<Cousot>::Result &R =
+    AM->getResult<InterProceduralRAAnalysis<Cousot> >(M);
+  std::unique_ptr<StrictRelations> SR(new StrictRelations());
+  SR->analyze(M, R.getAnalysis());
+  if(Freeze)
+    SR->freeze();
+  return Result(std::move(SR));
+}
+
+// The result points into the ranges, so it goes away with them
+bool StrictRelationsAnalysis::Result::invalidate(Module &M,
+                                                 const PreservedAnalyses &PA) {
+  return !PA.preserved(ID()) or
+         !PA.preserved(InterProceduralRAAnalysis<Cousot>::ID());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Query index
+
+void StrictRelations::QueryIndex::setValues(std::vector<const Value*> &&V) {
+  values = std::move(V);
+  std::sort(values.begin(), values.end());
+  values.erase(std::unique(values.begin(), values.end()), values.end());
+  unsigned n = values.size();
+  node.assign(n, NULL);
+  cls.assign(n, 0);
+  flags.assign(n, 0);
+  locs.assign(n, SparseBitVector<>());
+  var.assign(n, None);
+  ltData.clear();
+  gtData.clear();
+  ltBegin.assign(1, 0);
+  gtBegin.assign(1, 0);
+}
+
+void StrictRelations::QueryIndex::addRow(VariableSet &LT, VariableSet &GT) {
+  for(auto w : LT) ltData.push_back(w);
+  for(auto w : GT) gtData.push_back(w);
+  ltBegin.push_back(ltData.size());
+  gtBegin.push_back(gtData.size());
+}
+
+void StrictRelations::QueryIndex::clear() {
+  // Swapped with empty vectors, so that their memory is freed
+  std::vector<const Value*>().swap(values);
+  std::vector<DepNode*>().swap(node);
+  std::vector<unsigned>().swap(cls);
+  std::vector<unsigned char>().swap(flags);
+  std::vector< SparseBitVector<> >().swap(locs);
+  std::vector<VarId>().swap(var);
+  std::vector<VarId>().swap(ltData);
+  std::vector<VarId>().swap(gtData);
+  std::vector<unsigned>().swap(ltBegin);
+  std::vector<unsigned>().swap(gtBegin);
 }
 
-void StrictRelations::propagateAlloca(DepNode* alloca) {
-  std::queue<DepNode*>to_visit;
-  std::unordered_set<DepNode*>visited;
+void StrictRelations::freeze() {
+  if(frozen or kernel or !arena) return;
+  uint64_t t = Timing != NoTiming ? Profile::ticks() : 0;
   
-  to_visit.push(alloca);
-  const Value* a = alloca->v;
-  while(!(to_visit.empty())){
-    DepNode* current = to_visit.front();
-    to_visit.pop();
-    current->locs.insert(a);
-    visited.insert(current);
-    
-    for(auto i : current->outedges){
-      if(!(visited.count(i->in))){
-       to_visit.push(i->in);
+  std::vector<const Value*> Values;
+  Values.reserve(nodes.size() + variables.size());
+  for(auto &N : nodes) Values.push_back(N.first);
+  for(VarId v = 0, e = variables.size(); v != e; ++v)
+    if(!variables.isRetired(v)) Values.push_back(variables.getValue(v));
+  index.setValues(std::move(Values));
+  
+  for(auto &N : nodes) {
+    unsigned i = index.lookup(N.first);
+    DepNode* n = N.second;
+    index.node[i] = n;
+    index.cls[i] = nodeClasses.find(n->id);
+    index.flags[i] = getFlags(n);
+    // Only the index keeps the allocation sites
+    index.locs[i] = n->locs;
+    n->locs.clear();
+  }
+  VariableSet Empty;
+  for(VarId v = 0, e = variables.size(); v != e; ++v) {
+    if(!variables.isRetired(v))
+      index.var[index.lookup(variables.getValue(v))] = variables.find(v);
+    // Rows of collapsed variables stay empty
+    if(variables.find(v) == v)
+      index.addRow(variables.LT(v), variables.GT(v));
+    else
+      index.addRow(Empty, Empty);
+  }
+  
+  // Updates find the components a function was in from the variables its
+  // constraints used
+  SmallVector<std::pair<VarId, VarId>, 8> edges;
+  for(auto &F : functions) {
+    FunctionInfo &Info = F.second;
+    Info.touched.clear();
+    for(auto c : Info.constraints) {
+      edges.clear();
+      c->getFlow(edges);
+      for(auto e : edges) {
+        Info.touched.push_back(e.first);
+        Info.touched.push_back(e.second);
       }
     }
+    std::sort(Info.touched.begin(), Info.touched.end());
+    Info.touched.erase(std::unique(Info.touched.begin(), Info.touched.end()),
+                       Info.touched.end());
+    std::vector<const Constraint*>().swap(Info.constraints);
   }
+  
+  // What only the solver needs. The must alias classes of the nodes, and
+  // what each function added, stay for the updates.
+  delete wle;
+  wle = NULL;
+  delete constraintArena;
+  constraintArena = NULL;
+  variables.freeze();
+  std::unordered_map<const Value*, DepNode*>().swap(nodes);
+  std::vector<const Value*>().swap(allocSites);
+  frozen = true;
+  
+  if(Timing != NoTiming)
+    prof.updatePhase("Freeze", Profile::ticks() - t);
 }
 
-void StrictRelations::DepNode::getPathToRoot() {
-  DepNode* current = this;
-  int index = 0;
-  Range offset = Range(Zero,Zero);
-  while(true) {
-    path_to_root[current] = std::pair<int, Range>(index, offset);
-    if(current->inedges.size() == 1) {
-      DepEdge* addr = *(current->inedges.begin());
-      current = addr->out;
-      if(path_to_root.count(current)) {
-        //This means that the local tree is actually a lonely loop
-      	// so the local tree's root will be the pointer with the highest address
-      	DepNode* root = NULL;
-      	for(auto i : path_to_root){
-      		if(root < i.first) root = i.first;
-      	}
-      	local_root = root;
-      	break;
+////////////////////////////////////////////////////////////////////////////////
+// Incremental updates
+
+// Drops what F added: its constraints and variables, its nodes with their
+// edges, and the edges its code gave to the nodes of other functions
+void StrictRelations::retractFunction(const Function* F,
+                                      DenseSet<const Constraint*> &Dead,
+                                      DenseSet<DepNode*> &DeadNodes) {
+  auto it = functions.find(F);
+  if(it == functions.end()) return;
+  FunctionInfo &Info = it->second;
+  Dead.insert(Info.constraints.begin(), Info.constraints.end());
+  for(auto v : Info.vars) variables.retire(v);
+  
+  SmallVector<DepEdge*, 8> edges;
+  for(auto n : Info.nodes) {
+    edges.assign(n->inedges.begin(), n->inedges.end());
+    edges.append(n->outedges.begin(), n->outedges.end());
+    for(auto e : edges) DepEdge::deleteEdge(e);
+    nodes.erase(n->v);
+    DeadNodes.insert(n);
+  }
+  for(auto e : Info.edges) DepEdge::deleteEdge(e);
+  functions.erase(it);
+}
+
+void StrictRelations::thaw(Module &M, ArrayRef<const Function*> Changed) {
+  for(unsigned i = 0, e = index.size(); i != e; ++i)
+    if(DepNode* n = index.node[i]) nodes[index.getValue(i)] = n;
+  variables.thaw();
+  for(VarId v = 0, e = variables.size(); v != e; ++v) {
+    if(variables.find(v) != v) continue;
+    for(auto w : index.LT(v)) variables.LT(v).insert(w);
+    for(auto w : index.GT(v)) variables.GT(v).insert(w);
+  }
+  index.clear();
+  frozen = false;
+  
+  // The update collects the functions that changed
+  constraintArena = new ConstraintArena();
+  wle = new WorkListEngine(&variables);
+  DenseSet<const Function*> changed(Changed.begin(), Changed.end());
+  if(scope) {
+    if(!changed.count(scope)) collectConstraintsFromFunction(*scope);
+    return;
+  }
+  for(Function &F : M)
+    if(!changed.count(&F)) collectConstraintsFromFunction(F);
+}
+
+void StrictRelations::updateFunctions(Module &M,
+                                      ArrayRef<const Function*> Changed) {
+  NumUpdates++;
+  bool refreeze = frozen;
+  auto analyzeAgain = [&]() {
+    analyzeModule(M);
+    if(refreeze)
+      freeze();
+  };
+  // Collapsed variables cannot be split again
+  if(Collapse or partialGraph) {
+    analyzeAgain();
+    return;
+  }
+  DEBUG_WITH_TYPE("phases", errs() << "Updating " << Changed.size()
+                                   << " functions.\n");
+  // The other functions give their constraints again, and the relations
+  // come back from the index
+  if(frozen)
+    thaw(M, Changed);
+  
+  // Variables that lost a constraint: the ones the dead constraints used,
+  // and the ones the constraints freed by freeze() used
+  std::vector<VarId> seeds;
+  DenseSet<const Constraint*> dead;
+  DenseSet<DepNode*> deadNodes;
+  for(auto F : Changed) {
+    auto it = functions.find(F);
+    if(it != functions.end())
+      seeds.insert(seeds.end(), it->second.touched.begin(),
+                   it->second.touched.end());
+    retractFunction(F, dead, deadNodes);
+  }
+  SmallVector<std::pair<VarId, VarId>, 8> edges;
+  for(auto c : dead) {
+    edges.clear();
+    c->getFlow(edges);
+    for(auto e : edges) {
+      seeds.push_back(e.first);
+      seeds.push_back(e.second);
+    }
+  }
+  for(auto v : seeds) variables.removeConstraints(v, dead);
+  wle->remove(dead);
+  NumConstraintsRetracted += dead.size();
+  NumConstraintsKept += wle->getNumConstraints();
+  NumNodesRetracted += deadNodes.size();
+  NumNodesKept += nodes.size();
+  
+  // Must alias classes cannot be split, so they are joined again without
+  // the retracted variables and nodes
+  variables.rebuildMustAlias();
+  nodeClasses.reset();
+  std::vector< std::pair<DepNode*, DepNode*> > joins;
+  joins.swap(nodeJoins);
+  for(auto j : joins)
+    if(!deadNodes.count(j.first) and !deadNodes.count(j.second))
+      joinNodes(j.first, j.second);
+  
+  // Collecting the changed functions that are still in the module
+  DenseSet<const Function*> changed(Changed.begin(), Changed.end());
+  std::vector<Function*> live;
+  for(auto F = M.begin(), Fe = M.end(); F != Fe; F++)
+    if(changed.count(F)) live.push_back(F);
+  unsigned firstNew = wle->getNumConstraints();
+  std::set<const Value*> pointers;
+  for(auto F : live) {
+    collectConstraintsFromFunction(*F);
+    collectPointers(*F, pointers);
+  }
+  NumFunctionsUpdated += live.size();
+  
+  // New nodes get all their edges. Kept nodes get the edges that come from
+  // the new code: the arguments of the functions it calls, and the calls to
+  // the changed functions. A call with too few arguments stops a whole
+  // build, so the update gives way to one.
+  std::vector<DepNode*> list;
+  DenseSet<DepNode*> fresh;
+  for(auto p : pointers) {
+    if(nodes.count(p)) continue;
+    DepNode* n = newNode(p);
+    nodes[p] = n;
+    list.push_back(n);
+    fresh.insert(n);
+  }
+  for(auto n : list)
+    if(!addEdges(n)) {
+      analyzeAgain();
+      return;
+    }
+  for(auto F : live) {
+    for (inst_iterator I = inst_begin(F), E = inst_end(F); I != E; ++I) {
+      const CallInst* caller = dyn_cast<CallInst>(&*I);
+      Function* CF = caller ? caller->getCalledFunction() : NULL;
+      if(!CF) continue;
+      for(auto a = CF->arg_begin(), ae = CF->arg_end(); a != ae; ++a) {
+        auto n = nodes.find(a);
+        if(n != nodes.end() and !fresh.count(n->second) and
+           !addArgumentEdge(n->second, a, caller)) {
+          analyzeAgain();
+          return;
+        }
       }
-      index++;
-      offset = offset.add(addr->range);
+    }
+    for(auto ui = F->user_begin(), ue = F->user_end(); ui != ue; ui++) {
+      const CallInst* caller = dyn_cast<CallInst>(*ui);
+      if(!caller) continue;
+      auto n = nodes.find(caller);
+      if(n != nodes.end() and !fresh.count(n->second))
+        addCallEdges(n->second, caller);
+    }
+  }
+  
+  // Types and trees are linear in the graph, and are found again
+  collectTypes();
+  propagateTypes();
+  buildForest();
+  
+  // Only the weakly connected components of the constraint graph that lost
+  // or got a constraint are solved again; the others keep their relations
+  const std::vector<const Constraint*> &C = wle->getConstraints();
+  for(unsigned i = firstNew, end = C.size(); i != end; ++i) {
+    edges.clear();
+    C[i]->getFlow(edges);
+    for(auto e : edges) seeds.push_back(e.first);
+  }
+  UnionFind components;
+  for(VarId v = 0, e = variables.size(); v != e; ++v) components.add();
+  for(auto c : C) {
+    edges.clear();
+    c->getFlow(edges);
+    for(auto e : edges) components.join(e.first, e.second);
+  }
+  DenseSet<unsigned> affected;
+  for(auto v : seeds) affected.insert(components.find(v));
+  for(VarId v = 0, e = variables.size(); v != e; ++v) {
+    if(variables.isRetired(v)) continue;
+    if(affected.count(components.find(v))) {
+      variables.LT(v).clear();
+      variables.GT(v).clear();
+      NumVariablesResolved++;
     } else {
-      local_root = current;
-      break;
+      NumVariablesKept++;
     }
   }
+  std::vector<const Constraint*> todo;
+  for(auto c : C)
+    if(affected.count(components.find(c->getTarget()))) todo.push_back(c);
+  
+  cache.clear();
+  if(Schedule == SCCSchedule)
+    wle->schedule();
+  if(Lazy) {
+    // The kept components are solved already, and solving them on demand
+    // again changes nothing
+    delete kernel;
+    kernel = new ConstraintKernel(*wle);
+  } else {
+    wle->solve(todo);
+  }
+  if(refreeze)
+    freeze();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 // WorkListEngine definitions
 
+typedef StrictRelations::VarId VarId;
+
 void WorkListEngine::solve() {
-  for(auto i : constraints) push(i.first);
+  solve(constraints);
+}
+
+void WorkListEngine::solve(ArrayRef<const Constraint*> Seeds) {
+  worklist.setNumRanks(numRanks);
+  for(auto i : Seeds) push(i);
   
   while(!worklist.empty()) {
-    const Constraint* c = worklist.front();
-    worklist.pop();
-    constraints[c] = false;
+    const Constraint* c = worklist.pop();
+    queued[c->id] = false;
     DEBUG_WITH_TYPE("worklist", errs() << "=> ");
     DEBUG_WITH_TYPE("worklist", c->print(errs()));
     c->resolve();
@@ -1571,76 +2570,214 @@ void WorkListEngine::solve() {
   }
 }
 
-void WorkListEngine::add(const Constraint* C) {
-  if(!constraints.count(C))
-    constraints[C] = false;
+void WorkListEngine::add(Constraint* C) {
+  C->id = constraints.size();
+  constraints.push_back(C);
+  queued.push_back(false);
 }
 
-WorkListEngine::~WorkListEngine() {
-  for(auto i : constraints)
-    delete i.first;
+void WorkListEngine::remove(const DenseSet<const Constraint*> &Dead) {
+  unsigned n = 0;
+  for(unsigned i = 0, e = constraints.size(); i != e; ++i) {
+    const Constraint* c = constraints[i];
+    if(Dead.count(c)) continue;
+    c->id = n;
+    constraints[n++] = c;
+  }
+  constraints.resize(n);
+  queued.assign(n, false);
+  ranks.clear();
+  numRanks = 1;
+  collapsed.clear();
+}
+
+unsigned WorkListEngine::getRank(const Constraint* C) const {
+  if(ranks.empty()) return 0;
+  return ranks[C->id];
+}
+
+// Iterative Tarjan over a graph of variables. Components are numbered sinks
+// first, so the topological rank of component k is numComponents - 1 - k.
+// Returns the number of components.
+static unsigned findComponents
+                        (const std::vector< SmallVector<VarId, 4> > &succs,
+                         std::vector<unsigned> &component) {
+  unsigned n = succs.size();
+  const unsigned unvisited = ~0u;
+  std::vector<unsigned> index(n, unvisited), low(n);
+  std::vector<bool> onStack(n, false);
+  std::vector<VarId> stack;
+  std::vector< std::pair<VarId, unsigned> > frames;
+  unsigned next = 0, numComponents = 0;
+  component.assign(n, 0);
+  
+  for(VarId root = 0; root != n; ++root) {
+    if(index[root] != unvisited) continue;
+    frames.push_back(std::make_pair(root, 0u));
+    index[root] = low[root] = next++;
+    stack.push_back(root);
+    onStack[root] = true;
+    
+    while(!frames.empty()) {
+      VarId v = frames.back().first;
+      unsigned &i = frames.back().second;
+      if(i < succs[v].size()) {
+        VarId w = succs[v][i++];
+        if(index[w] == unvisited) {
+          frames.push_back(std::make_pair(w, 0u));
+          index[w] = low[w] = next++;
+          stack.push_back(w);
+          onStack[w] = true;
+        } else if(onStack[w]) {
+          low[v] = std::min(low[v], index[w]);
+        }
+        continue;
+      }
+      
+      frames.pop_back();
+      if(low[v] == index[v]) {
+        VarId w;
+        do {
+          w = stack.back();
+          stack.pop_back();
+          onStack[w] = false;
+          component[w] = numComponents;
+        } while(w != v);
+        numComponents++;
+      }
+      if(!frames.empty()) {
+        VarId u = frames.back().first;
+        low[u] = std::min(low[u], low[v]);
+      }
+    }
+  }
+  return numComponents;
+}
+
+void WorkListEngine::schedule() {
+  // Variable graph: an edge x -> y means LT(x) flows into LT(y)
+  std::vector< SmallVector<VarId, 4> > succs(vars->size());
+  SmallVector<std::pair<VarId, VarId>, 8> edges;
+  for(auto c : constraints) {
+    edges.clear();
+    c->getFlow(edges);
+    for(auto e : edges) succs[e.first].push_back(e.second);
+  }
+  
+  std::vector<unsigned> component;
+  unsigned numComponents = findComponents(succs, component);
+  numRanks = numComponents ? numComponents : 1;
+  ranks.resize(constraints.size());
+  for(auto c : constraints)
+    ranks[c->id] = numComponents - 1 - component[c->getTarget()];
+  NumComponents += numComponents;
+}
+
+bool WorkListEngine::isCollapsed(const Constraint* C) const {
+  return !collapsed.empty() and collapsed[C->id];
+}
+
+void WorkListEngine::collapse() {
+  // Graph of the <= and == constraints: every cycle in it is a set of equal
+  // variables, with the same strict relations.
+  unsigned n = vars->size();
+  std::vector< SmallVector<VarId, 4> > succs(n);
+  SmallVector<std::pair<VarId, VarId>, 8> edges;
+  for(auto c : constraints) {
+    if(!c->isNonStrict()) continue;
+    edges.clear();
+    c->getFlow(edges);
+    for(auto e : edges) succs[e.first].push_back(e.second);
+  }
+  
+  std::vector<unsigned> component;
+  unsigned numComponents = findComponents(succs, component);
+  
+  // The representative of a component is its first variable
+  std::vector<VarId> first(numComponents, ~0u);
+  for(VarId v = 0; v != n; ++v) {
+    VarId &r = first[component[v]];
+    if(r == ~0u) r = v;
+    else {
+      vars->collapse(v, r);
+      NumCollapsed++;
+    }
+  }
+  
+  // Constraints inside a component do nothing anymore. A collapsed constraint
+  // is marked as queued, so it is never pushed.
+  collapsed.assign(constraints.size(), false);
+  for(auto c : constraints) {
+    if(!c->isNonStrict()) continue;
+    edges.clear();
+    c->getFlow(edges);
+    if(vars->find(edges[0].first) == vars->find(edges[0].second)) {
+      collapsed[c->id] = true;
+      queued[c->id] = true;
+    }
+  }
 }
 
 void WorkListEngine::printConstraints(raw_ostream &OS) {
   OS << "Constraints:\n";
   OS << "-------------------------------------------------\n";
   for(auto i : constraints)
-    i.first->print(OS);
+    i->print(OS);
   OS << "-------------------------------------------------\n";
 }
 
 void WorkListEngine::push(const Constraint* C) {
-  if(constraints.count(C) and !constraints.at(C)) {
-    worklist.push(C);
-    constraints[C] = true;
+  if(!queued[C->id]) {
+    worklist.push(C, getRank(C));
+    queued[C->id] = true;
   }
 }
 ////////////////////////////////////////////////////////////////////////////////
 // Constraints definitions
 
 // LT(x) U= {y}
-void insertLT(StrictRelations::Variable* x,
-                               StrictRelations::Variable* y,
+void insertLT(StrictRelations::VariableTable &V, VarId x, VarId y,
                                StrictRelations::VariableSet &changed) {
-  if(!x->LT.count(y) and x != y) {
-    x->LT.insert(y);
+  x = V.find(x);
+  y = V.find(y);
+  if(!V.LT(x).count(y) and x != y) {
+    V.LT(x).insert(y);
     changed.insert(x);
-    if(!y->GT.count(x)) {
-      y->GT.insert(x);
+    if(!V.GT(y).count(x)) {
+      V.GT(y).insert(x);
       changed.insert(y);
     }
   }
 }
 
 // GT(x) U= {y}
-void insertGT(StrictRelations::Variable* x,
-                               StrictRelations::Variable* y,
+void insertGT(StrictRelations::VariableTable &V, VarId x, VarId y,
                                StrictRelations::VariableSet &changed) {
-  if(!x->GT.count(y) and x != y) {
-    x->GT.insert(y);
+  x = V.find(x);
+  y = V.find(y);
+  if(!V.GT(x).count(y) and x != y) {
+    V.GT(x).insert(y);
     changed.insert(x);
-    if(!y->LT.count(x)) {
-      y->LT.insert(x);
+    if(!V.LT(y).count(x)) {
+      V.LT(y).insert(x);
       changed.insert(y);
     }
   }
 }
 
 // LT(x) U= LT(y)
-void unionLT(StrictRelations::Variable* x,
-                               StrictRelations::Variable* y,
+void unionLT(StrictRelations::VariableTable &V, VarId x, VarId y,
                                StrictRelations::VariableSet &changed) {
-  for(auto i : y->LT) {
-    insertLT(x, i, changed);
+  for(auto i : V.LT(y)) {
+    insertLT(V, x, i, changed);
   }
 }
 
 // GT(x) U= GT(y)
-void unionGT(StrictRelations::Variable* x,
-                               StrictRelations::Variable* y,
+void unionGT(StrictRelations::VariableTable &V, VarId x, VarId y,
                                StrictRelations::VariableSet &changed) {
-  for(auto i : y->GT) {
-    insertGT(x, i, changed);
+  for(auto i : V.GT(y)) {
+    insertGT(V, x, i, changed);
   }
 }
 
@@ -1652,77 +2789,77 @@ StrictRelations::VariableSet intersect
   return r;
 }
 
+// Adds back the constraints of the variables in changed
+void pushChanged(WorkListEngine* engine, const Constraint* current,
+                 StrictRelations::VariableSet &changed) {
+  StrictRelations::VariableTable &V = engine->getVariables();
+  for(auto c : changed){
+    DEBUG_WITH_TYPE("worklist", V.printStrictRelations(c, errs()));
+    for(auto i : V.getConstraints(c))
+      if(i != current) engine->push(i);
+  }
+}
+
 void LT::resolve() const {
   // x < y
+  StrictRelations::VariableTable &V = engine->getVariables();
   StrictRelations::VariableSet changed;
   
   // LT(y) U= LT(x) U {x}
-  unionLT(right, left, changed);
-  insertLT(right, left, changed);
+  unionLT(V, right, left, changed);
+  insertLT(V, right, left, changed);
 
   // GT(x) U= GT(y) U {y}
-  unionGT(left, right, changed);
-  insertGT(left, right, changed);
+  unionGT(V, left, right, changed);
+  insertGT(V, left, right, changed);
 
   // Adding back constraints from changed abstract values
-  for(auto c : changed){
-    DEBUG_WITH_TYPE("worklist", c->printStrictRelations(errs()));
-    for(auto i : c->constraints)
-      if(i != this) engine->push(i);
-  }
+  pushChanged(engine, this, changed);
 }  
 void LE::resolve() const { 
   // x <= y
+  StrictRelations::VariableTable &V = engine->getVariables();
   StrictRelations::VariableSet changed;
   
   // LT(y) U= LT(x)
-    unionLT(right, left, changed);
+    unionLT(V, right, left, changed);
   // GT(x) U= GT(y)
-    unionGT(left, right, changed);
+    unionGT(V, left, right, changed);
   // Adding back constraints from changed abstract values
-  for(auto c : changed){
-    DEBUG_WITH_TYPE("worklist", c->printStrictRelations(errs()));
-    for(auto i : c->constraints)
-      if(i != this) engine->push(i);
-  }
+  pushChanged(engine, this, changed);
 }
 void REQ::resolve() const { 
   // x = y
+  StrictRelations::VariableTable &V = engine->getVariables();
   StrictRelations::VariableSet changed;
   // LT(x) U= LT(y)
-    unionLT(left, right, changed);
+    unionLT(V, left, right, changed);
   // LT(y) U= LT(x)
-    unionLT(right, left, changed);
+    unionLT(V, right, left, changed);
   // GT(x) U= GT(y)
-    unionGT(left, right, changed);
+    unionGT(V, left, right, changed);
   // GT(y) U= GT(x)
-    unionGT(right, left, changed);
+    unionGT(V, right, left, changed);
   // Adding back constraints from changed abstract values
-  for(auto c : changed) {
-    DEBUG_WITH_TYPE("worklist", c->printStrictRelations(errs()));
-    for(auto i : c->constraints)
-      if(i != this) engine->push(i);
-  }
+  pushChanged(engine, this, changed);
 }
 
 void EQ::resolve() const { 
   // x = y
+  StrictRelations::VariableTable &V = engine->getVariables();
   StrictRelations::VariableSet changed;
   // LT(x) U= LT(y)
-    unionLT(left, right, changed);
+    unionLT(V, left, right, changed);
   // GT(x) U= GT(y)
-    unionGT(left, right, changed);
+    unionGT(V, left, right, changed);
   // Adding back constraints from changed abstract values
-  for(auto c : changed) {
-    DEBUG_WITH_TYPE("worklist", c->printStrictRelations(errs()));
-    for(auto i : c->constraints)
-      if(i != this) engine->push(i);
-  }
+  pushChanged(engine, this, changed);
   
 }
 
 void PHI::resolve() const { 
   // x = I( xi )
+  StrictRelations::VariableTable &V = engine->getVariables();
   StrictRelations::VariableSet changed;
   // Growth checks
   bool gu = false, gd = false;
@@ -1730,19 +2867,23 @@ void PHI::resolve() const {
   //for (auto i : operands) if (i->GT.count(left)) { gd = true; break; }
   
   for (auto i : operands) {
-    for(auto j : *(left->mustalias)) {
-      if (i->LT.count(j)) { 
+    StrictRelations::VarId j = left;
+    do {
+      if (V.LT(i).count(V.find(j))) { 
         gu = true; break; 
       }
-    }
+      j = V.nextMustAlias(j);
+    } while(j != left);
   }
   
   for (auto i : operands) {
-    for(auto j : *(left->mustalias)) {
-      if (i->GT.count(j)) { 
+    StrictRelations::VarId j = left;
+    do {
+      if (V.GT(i).count(V.find(j))) { 
         gd = true; break; 
       }
-    }
+      j = V.nextMustAlias(j);
+    } while(j != left);
   }
   
   StrictRelations::VariableSet ULT, UGT;
@@ -1753,20 +2894,20 @@ void PHI::resolve() const {
     // Intersection part
     auto i = operands.begin();
     if(i != operands.end()) do {
-      ULT = (*i)->LT;
+      ULT = V.LT(*i);
       i++;
-    } while (ULT.count(left) and i != operands.end());
+    } while (ULT.count(V.find(left)) and i != operands.end());
     
     for (auto e = operands.end(); i != e; i++)
-      if(!(*i)->LT.count(left)) ULT = intersect(ULT, (*i)->LT);
+      if(!V.LT(*i).count(V.find(left))) ULT = intersect(ULT, V.LT(*i));
      
   } else {
     // LT(x) U= I( LT(xi) )
     auto i = operands.begin();
     if(i != operands.end()) {
-      ULT = (*i)->LT;
+      ULT = V.LT(*i);
       i++;
-      for (auto e = operands.end(); i != e; i++) ULT = intersect(ULT, (*i)->LT);
+      for (auto e = operands.end(); i != e; i++) ULT = intersect(ULT, V.LT(*i));
     }
   }
   
@@ -1776,111 +2917,617 @@ void PHI::resolve() const {
     // Intersection part
     auto i = operands.begin();
     if(i != operands.end()) do {
-    UGT = (*i)->GT;
+    UGT = V.GT(*i);
     i++;
-    } while (UGT.count(left) and i != operands.end());
+    } while (UGT.count(V.find(left)) and i != operands.end());
     
     for (auto e = operands.end(); i != e; i++)
-      if(!(*i)->GT.count(left)) UGT = intersect(UGT, (*i)->GT);
+      if(!V.GT(*i).count(V.find(left))) UGT = intersect(UGT, V.GT(*i));
     
   } else {
     // GT(x) U= I( GT(xi) )
     auto i = operands.begin();
     if(i != operands.end()) {
-      UGT = (*i)->GT;
+      UGT = V.GT(*i);
       i++;
-      for (auto e = operands.end(); i != e; i++) UGT = intersect(UGT, (*i)->GT);
+      for (auto e = operands.end(); i != e; i++) UGT = intersect(UGT, V.GT(*i));
     }
   }
   // Remove left from ULT and UGT
   //ULT.erase(left);
   //UGT.erase(left);
   
-  for(auto i : *(left->mustalias)) {
-    ULT.erase(i);
-    UGT.erase(i);
-  }
+  StrictRelations::VarId m = left;
+  do {
+    ULT.erase(V.find(m));
+    UGT.erase(V.find(m));
+    m = V.nextMustAlias(m);
+  } while(m != left);
   
   // U= part
-    for(auto i : ULT) insertLT(left, i, changed);
-    for(auto i : UGT) insertGT(left, i, changed);
+    for(auto i : ULT) insertLT(V, left, i, changed);
+    for(auto i : UGT) insertGT(V, left, i, changed);
   
   // Adding back constraints from changed abstract values
-  for(auto c : changed){
-    DEBUG_WITH_TYPE("worklist", c->printStrictRelations(errs()));
-    for(auto i : c->constraints)
-      if(i != this) engine->push(i);
-  }
+  pushChanged(engine, this, changed);
+}
+
+// Prints the name of the value, or the value itself if it has no name
+static void printValue(const Value* v, raw_ostream &OS) {
+  if(v->getValueName() == NULL) OS << *(v);
+  else OS << v->getName();
 }
 
 void LT::print(raw_ostream &OS) const {
-  if(left->v->getValueName() == NULL) OS << *(left->v);
-  else OS << left->v->getName();
+  StrictRelations::VariableTable &V = engine->getVariables();
+  printValue(V.getValue(left), OS);
   OS << " < ";
-  if(right->v->getValueName() == NULL) OS << *(right->v);
-  else OS << right->v->getName();
+  printValue(V.getValue(right), OS);
   OS << "\n";
 }
 void LE::print(raw_ostream &OS) const {
-  if(left->v->getValueName() == NULL) OS << *(left->v);
-  else OS << left->v->getName();
+  StrictRelations::VariableTable &V = engine->getVariables();
+  printValue(V.getValue(left), OS);
   OS << " <= ";
-  if(right->v->getValueName() == NULL) OS << *(right->v);
-  else OS << right->v->getName();
+  printValue(V.getValue(right), OS);
   OS << "\n";
 }
 void REQ::print(raw_ostream &OS) const {
-  if(left->v->getValueName() == NULL) OS << *(left->v);
-  else OS << left->v->getName();
+  StrictRelations::VariableTable &V = engine->getVariables();
+  printValue(V.getValue(left), OS);
   OS << " == ";
-  if(right->v->getValueName() == NULL) OS << *(right->v);
-  else OS << right->v->getName();
+  printValue(V.getValue(right), OS);
   OS << "\n";
 }
 void EQ::print(raw_ostream &OS) const {
-  if(left->v->getValueName() == NULL) OS << *(left->v);
-  else OS << left->v->getName();
+  StrictRelations::VariableTable &V = engine->getVariables();
+  printValue(V.getValue(left), OS);
   OS << " = ";
-  if(right->v->getValueName() == NULL) OS << *(right->v);
-  else OS << right->v->getName();
+  printValue(V.getValue(right), OS);
   OS << "\n";
 }
 void PHI::print(raw_ostream &OS) const {
-  if(left->v->getValueName() == NULL) OS << *(left->v);
-  else OS << left->v->getName();
+  StrictRelations::VariableTable &V = engine->getVariables();
+  printValue(V.getValue(left), OS);
   OS << " = o| ";
   for(auto i : operands) {
-    if(i->v->getValueName() == NULL) OS << *(i->v);
-    else OS << i->v->getName();
+    printValue(V.getValue(i), OS);
     OS << "; ";
   }
   OS << "\n";
 }
 
-void StrictRelations::Variable::coalesce (StrictRelations::Variable* other){
-  if(mustalias == other->mustalias) return;
-  std::unordered_set<Variable*>* to_coalesce = other->mustalias;
-  for(auto i : *to_coalesce) i->mustalias = mustalias;
-  mustalias->insert(to_coalesce->begin(), to_coalesce->end());
-  delete to_coalesce;           
+unsigned LT::lower(ConstraintKernel &K) const {
+  return K.add(ConstraintKernel::LTKind, left, right, engine->getRank(this));
+}
+unsigned LE::lower(ConstraintKernel &K) const {
+  return K.add(ConstraintKernel::LEKind, left, right, engine->getRank(this));
+}
+unsigned REQ::lower(ConstraintKernel &K) const {
+  return K.add(ConstraintKernel::REQKind, left, right, engine->getRank(this));
+}
+unsigned EQ::lower(ConstraintKernel &K) const {
+  return K.add(ConstraintKernel::EQKind, left, right, engine->getRank(this));
+}
+unsigned PHI::lower(ConstraintKernel &K) const {
+  return K.addPHI(left, operands, engine->getRank(this));
 }
 
-void StrictRelations::Variable::printStrictRelations(raw_ostream &OS) {
-  if(v->getValueName() == NULL) OS << *(v);
-    else OS << v->getName();
+// x < y and x <= y: LT(x) flows into LT(y)
+void LT::getFlow(SmallVectorImpl<std::pair<VarId, VarId> > &Edges) const {
+  Edges.push_back(std::make_pair(left, right));
+}
+VarId LT::getTarget() const { return right; }
+void LE::getFlow(SmallVectorImpl<std::pair<VarId, VarId> > &Edges) const {
+  Edges.push_back(std::make_pair(left, right));
+}
+VarId LE::getTarget() const { return right; }
+// x = y: both variables are in the same component
+void REQ::getFlow(SmallVectorImpl<std::pair<VarId, VarId> > &Edges) const {
+  Edges.push_back(std::make_pair(left, right));
+  Edges.push_back(std::make_pair(right, left));
+}
+VarId REQ::getTarget() const { return left; }
+// x = y (sigma): LT(y) flows into LT(x)
+void EQ::getFlow(SmallVectorImpl<std::pair<VarId, VarId> > &Edges) const {
+  Edges.push_back(std::make_pair(right, left));
+}
+VarId EQ::getTarget() const { return left; }
+// x = I( xi ): every LT(xi) flows into LT(x)
+void PHI::getFlow(SmallVectorImpl<std::pair<VarId, VarId> > &Edges) const {
+  for(auto i : operands) Edges.push_back(std::make_pair(i, left));
+}
+VarId PHI::getTarget() const { return left; }
+
+////////////////////////////////////////////////////////////////////////////////
+// ConstraintKernel definitions
+
+ConstraintKernel::ConstraintKernel(WorkListEngine &W) {
+  vars = &W.getVariables();
+  numRanks = W.getNumRanks();
+  for(auto c : W.getConstraints()) {
+    unsigned h = c->lower(*this);
+    order.push_back(h);
+    // Collapsed constraints are never pushed
+    if(W.isCollapsed(c)) queued[getKind(h)][getIndex(h)] = true;
+  }
+  
+  // Same use lists, in the same order, as the variable table
+  uses.resize(vars->size());
+  for(VarId v = 0, e = vars->size(); v != e; ++v)
+    for(auto c : vars->getConstraints(v))
+      uses[v].push_back(order[c->getId()]);
+}
+
+unsigned ConstraintKernel::add(Kind K, VarId L, VarId R, unsigned Rank) {
+  Record r = {L, R, 0};
+  records[K].push_back(r);
+  queued[K].push_back(false);
+  ranks[K].push_back(Rank);
+  assert(records[K].size() < (1u << KindShift) && "Too many constraints");
+  return (K << KindShift) | (records[K].size() - 1);
+}
+
+unsigned ConstraintKernel::addPHI(VarId L, ArrayRef<VarId> Operands,
+                                  unsigned Rank) {
+  Record r = {L, (VarId)phiOperands.size(), 0};
+  phiOperands.insert(phiOperands.end(), Operands.begin(), Operands.end());
+  r.end = phiOperands.size();
+  records[PHIKind].push_back(r);
+  queued[PHIKind].push_back(false);
+  ranks[PHIKind].push_back(Rank);
+  return (PHIKind << KindShift) | (records[PHIKind].size() - 1);
+}
+
+void ConstraintKernel::push(Task &T, unsigned H) {
+  unsigned char &q = queued[getKind(H)][getIndex(H)];
+  if(!q) {
+    T.worklist.push(H, ranks[getKind(H)][getIndex(H)]);
+    q = true;
+  }
+}
+
+void ConstraintKernel::solve(unsigned Threads) {
+  if(Threads <= 1) {
+    Task T;
+    T.worklist.setNumRanks(numRanks);
+    solve(T, order);
+    return;
+  }
+  
+  std::vector< std::vector<unsigned> > components;
+  partition(components);
+  NumSolverTasks += components.size();
+  
+  // Threads take the next unsolved component until there are none left
+  std::atomic<unsigned> next(0);
+  auto worker = [&]() {
+    Task T;
+    T.worklist.setNumRanks(numRanks);
+    for(unsigned i = next++; i < components.size(); i = next++)
+      solve(T, components[i]);
+  };
+  std::vector<std::thread> pool;
+  for(unsigned i = 1; i < Threads; ++i) pool.push_back(std::thread(worker));
+  worker();
+  for(auto &t : pool) t.join();
+}
+
+template <class F>
+void ConstraintKernel::forEachVariable(unsigned H, F Fn) const {
+  const Record &R = records[getKind(H)][getIndex(H)];
+  Fn(R.left);
+  if(getKind(H) != PHIKind) Fn(R.right);
+  else for(unsigned i = R.right; i != R.end; ++i) Fn(phiOperands[i]);
+}
+
+void ConstraintKernel::solveFor(VarId v) {
+  if(componentOf.empty()) {
+    partition(components);
+    componentOf.assign(vars->size(), ~0u);
+    solved.assign(components.size(), false);
+    for(unsigned i = 0, e = components.size(); i != e; ++i)
+      for(auto h : components[i])
+        forEachVariable(h, [&](VarId w) { componentOf[w] = i; });
+  }
+  
+  unsigned c = componentOf[v];
+  if(c == ~0u) c = componentOf[vars->find(v)];
+  if(c == ~0u or solved[c]) return;
+  solved[c] = true;
+  NumLazySolves++;
+  Task T;
+  T.worklist.setNumRanks(numRanks);
+  solve(T, components[c]);
+}
+
+void ConstraintKernel::partition
+                          (std::vector< std::vector<unsigned> > &Components) {
+  // Union-find over the variables of the records
+  std::vector<VarId> parent(vars->size());
+  for(VarId v = 0, e = parent.size(); v != e; ++v) parent[v] = vars->find(v);
+  auto root = [&](VarId v) {
+    while(parent[v] != v) v = parent[v] = parent[parent[v]];
+    return v;
+  };
+  auto join = [&](VarId a, VarId b) {
+    a = root(a);
+    b = root(b);
+    if(a < b) parent[b] = a;
+    else parent[a] = b;
+  };
+  for(auto h : order) {
+    VarId left = records[getKind(h)][getIndex(h)].left;
+    forEachVariable(h, [&](VarId v) { join(left, v); });
+  }
+  
+  DenseMap<VarId, unsigned> index;
+  for(auto h : order) {
+    const Record &R = records[getKind(h)][getIndex(h)];
+    auto it = index.insert(std::make_pair(root(R.left), Components.size()));
+    if(it.second) Components.push_back(std::vector<unsigned>());
+    Components[it.first->second].push_back(h);
+  }
+  
+  // Largest components first, so that no thread is left with a big one at
+  // the end
+  std::stable_sort(Components.begin(), Components.end(),
+                   [](const std::vector<unsigned> &A,
+                      const std::vector<unsigned> &B) {
+                     return A.size() > B.size();
+                   });
+}
+
+void ConstraintKernel::solve(Task &T, ArrayRef<unsigned> Handles) {
+  for(auto h : Handles) push(T, h);
+  
+  while(!T.worklist.empty()) {
+    unsigned h = T.worklist.pop();
+    queued[getKind(h)][getIndex(h)] = false;
+    resolve(T, h);
+    NumResolve++;
+    
+    // Adding back constraints from changed abstract values
+    for(auto v : T.changed) {
+      DEBUG_WITH_TYPE("worklist", vars->printStrictRelations(v, errs()));
+      for(auto i : uses[v])
+        if(i != h) push(T, i);
+    }
+    T.changed.clear();
+  }
+}
+
+// LT(x) U= {y}
+void ConstraintKernel::insertLT(Task &T, VarId x, VarId y) {
+  x = vars->find(x);
+  y = vars->find(y);
+  if(!vars->LT(x).count(y) and x != y) {
+    vars->LT(x).insert(y);
+    T.changed.insert(x);
+    if(!vars->GT(y).count(x)) {
+      vars->GT(y).insert(x);
+      T.changed.insert(y);
+    }
+  }
+}
+
+// GT(x) U= {y}
+void ConstraintKernel::insertGT(Task &T, VarId x, VarId y) {
+  x = vars->find(x);
+  y = vars->find(y);
+  if(!vars->GT(x).count(y) and x != y) {
+    vars->GT(x).insert(y);
+    T.changed.insert(x);
+    if(!vars->LT(y).count(x)) {
+      vars->LT(y).insert(x);
+      T.changed.insert(y);
+    }
+  }
+}
+
+// LT(x) U= S \ {x}, keeping GT the transpose of LT
+void ConstraintKernel::joinLT(Task &T, VarId x,
+                              StrictRelations::VariableSet &S) {
+  StrictRelations::VariableSet added;
+  x = vars->find(x);
+  added.difference(S, vars->LT(x));
+  added.erase(x);
+  if(!vars->LT(x).unionWith(added)) return;
+  T.changed.insert(x);
+  for(auto i : added)
+    if(!vars->GT(i).count(x)) {
+      vars->GT(i).insert(x);
+      T.changed.insert(i);
+    }
+}
+
+// GT(x) U= S \ {x}, keeping LT the transpose of GT
+void ConstraintKernel::joinGT(Task &T, VarId x,
+                              StrictRelations::VariableSet &S) {
+  StrictRelations::VariableSet added;
+  x = vars->find(x);
+  added.difference(S, vars->GT(x));
+  added.erase(x);
+  if(!vars->GT(x).unionWith(added)) return;
+  T.changed.insert(x);
+  for(auto i : added)
+    if(!vars->LT(i).count(x)) {
+      vars->LT(i).insert(x);
+      T.changed.insert(i);
+    }
+}
+
+void ConstraintKernel::resolve(Task &T, unsigned H) {
+  const Record &R = records[getKind(H)][getIndex(H)];
+  switch(getKind(H)) {
+  case LTKind:
+    // LT(y) U= LT(x) U {x}
+    joinLT(T, R.right, vars->LT(R.left));
+    insertLT(T, R.right, R.left);
+    // GT(x) U= GT(y) U {y}
+    joinGT(T, R.left, vars->GT(R.right));
+    insertGT(T, R.left, R.right);
+    break;
+  case LEKind:
+    // LT(y) U= LT(x)
+    joinLT(T, R.right, vars->LT(R.left));
+    // GT(x) U= GT(y)
+    joinGT(T, R.left, vars->GT(R.right));
+    break;
+  case REQKind:
+    joinLT(T, R.left, vars->LT(R.right));
+    joinLT(T, R.right, vars->LT(R.left));
+    joinGT(T, R.left, vars->GT(R.right));
+    joinGT(T, R.right, vars->GT(R.left));
+    break;
+  case EQKind:
+    joinLT(T, R.left, vars->LT(R.right));
+    joinGT(T, R.left, vars->GT(R.right));
+    break;
+  case PHIKind:
+    resolvePHI(T, R);
+    break;
+  default:
+    llvm_unreachable("Unknown constraint kind");
+  }
+}
+
+void ConstraintKernel::resolvePHI(Task &T, const Record &R) {
+  // x = I( xi )
+  VarId left = vars->find(R.left);
+  const VarId *ob = phiOperands.data() + R.right;
+  const VarId *oe = phiOperands.data() + R.end;
+  
+  // Growth checks
+  bool gu = false, gd = false;
+  // The must alias class of left is a ring through nextMustAlias
+  for(const VarId *i = ob; i != oe and !gu; ++i) {
+    VarId j = left;
+    do {
+      if(vars->LT(*i).count(vars->find(j))) { gu = true; break; }
+      j = vars->nextMustAlias(j);
+    } while(j != left);
+  }
+  for(const VarId *i = ob; i != oe and !gd; ++i) {
+    VarId j = left;
+    do {
+      if(vars->GT(*i).count(vars->find(j))) { gd = true; break; }
+      j = vars->nextMustAlias(j);
+    } while(j != left);
+  }
+  
+  StrictRelations::VariableSet ULT, UGT;
+  
+  if(gu and !gd) {
+    // LT(x) U= I( LT(xj) ), where x !E LT(xj)
+    const VarId *i = ob;
+    if(i != oe) do {
+      ULT = vars->LT(*i);
+      i++;
+    } while (ULT.count(left) and i != oe);
+    for(; i != oe; i++)
+      if(!vars->LT(*i).count(left)) ULT.intersectWith(vars->LT(*i));
+  } else if(ob != oe) {
+    // LT(x) U= I( LT(xi) )
+    ULT = vars->LT(*ob);
+    for(const VarId *i = ob + 1; i != oe; i++) ULT.intersectWith(vars->LT(*i));
+  }
+  
+  if(!gu and gd) {
+    // GT(x) U= I( GT(xj) ), where x !E GT(xj)
+    const VarId *i = ob;
+    if(i != oe) do {
+      UGT = vars->GT(*i);
+      i++;
+    } while (UGT.count(left) and i != oe);
+    for(; i != oe; i++)
+      if(!vars->GT(*i).count(left)) UGT.intersectWith(vars->GT(*i));
+  } else if(ob != oe) {
+    // GT(x) U= I( GT(xi) )
+    UGT = vars->GT(*ob);
+    for(const VarId *i = ob + 1; i != oe; i++) UGT.intersectWith(vars->GT(*i));
+  }
+  
+  VarId m = left;
+  do {
+    ULT.erase(vars->find(m));
+    UGT.erase(vars->find(m));
+    m = vars->nextMustAlias(m);
+  } while(m != left);
+  
+  joinLT(T, left, ULT);
+  joinGT(T, left, UGT);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// VariableTable definitions
+
+void StrictRelations::VariableTable::clear() {
+  values.clear();
+  lt.clear();
+  gt.clear();
+  constraints.clear();
+  mustalias.clear();
+  joins.clear();
+  rep.clear();
+  ids.clear();
+}
+
+StrictRelations::VarId
+StrictRelations::VariableTable::getOrInsert(const Value* V) {
+  auto it = ids.find(V);
+  if(it != ids.end()) return it->second;
+  
+  VarId v = values.size();
+  ids[V] = v;
+  values.push_back(V);
+  lt.push_back(VariableSet());
+  gt.push_back(VariableSet());
+  constraints.push_back(SmallVector<Constraint*, 4>());
+  mustalias.add();
+  rep.push_back(v);
+  return v;
+}
+
+void StrictRelations::VariableTable::addConstraint(VarId v, Constraint* c) {
+  // A constraint may use the same variable twice
+  if(constraints[v].empty() or constraints[v].back() != c)
+    constraints[v].push_back(c);
+}
+
+void StrictRelations::VariableTable::removeConstraints(VarId v,
+                                     const DenseSet<const Constraint*> &Dead) {
+  SmallVector<Constraint*, 4> &C = constraints[v];
+  C.erase(std::remove_if(C.begin(), C.end(), [&](const Constraint* c) {
+    return Dead.count(c) != 0;
+  }), C.end());
+}
+
+void StrictRelations::VariableTable::retire(VarId v) {
+  ids.erase(values[v]);
+  values[v] = NULL;
+  lt[v].clear();
+  gt[v].clear();
+  constraints[v].clear();
+}
+
+void StrictRelations::VariableTable::rebuildMustAlias() {
+  mustalias.reset();
+  std::vector< std::pair<VarId, VarId> > old;
+  old.swap(joins);
+  for(auto j : old)
+    if(!isRetired(j.first) and !isRetired(j.second))
+      coalesce(j.first, j.second);
+}
+
+void StrictRelations::VariableTable::freeze() {
+  // Swapped with empty containers, so that their memory is freed
+  std::vector<VariableSet>().swap(lt);
+  std::vector<VariableSet>().swap(gt);
+  std::vector< SmallVector<Constraint*, 4> >().swap(constraints);
+  mustalias = UnionFind();
+  std::vector< std::pair<VarId, VarId> >().swap(joins);
+}
+
+void StrictRelations::VariableTable::thaw() {
+  unsigned n = values.size();
+  lt.resize(n);
+  gt.resize(n);
+  constraints.resize(n);
+  for(unsigned v = 0; v != n; ++v) mustalias.add();
+}
+
+void StrictRelations::VariableTable::collapse(VarId v, VarId r) {
+  assert(rep[v] == v and rep[r] == r && "Variable already collapsed");
+  assert(lt[v].empty() and gt[v].empty() && "Collapsing after solving");
+  coalesce(r, v);
+  rep[v] = r;
+  // The representative is changed whenever v would have been
+  constraints[r].append(constraints[v].begin(), constraints[v].end());
+  constraints[v].clear();
+}
+
+// Each set is a list of ULEB128 gaps between its ascending members, the
+// first one counting from -1, ended by a zero
+static void writeSet(StrictRelations::VariableSet &S, raw_ostream &OS) {
+  uint64_t prev = 0;
+  for(auto i : S) {
+    encodeULEB128(i + 1 - prev, OS);
+    prev = i + 1;
+  }
+  encodeULEB128(0, OS);
+}
+
+static bool readULEB128(const uint8_t *&P, const uint8_t *E, uint64_t &V) {
+  V = 0;
+  for(unsigned shift = 0; P != E and shift < 64; shift += 7) {
+    uint8_t byte = *P++;
+    V |= uint64_t(byte & 0x7f) << shift;
+    if(!(byte & 0x80)) return true;
+  }
+  return false;
+}
+
+static bool readSet(StrictRelations::VariableSet &S, unsigned Size,
+                    const uint8_t *&P, const uint8_t *E) {
+  uint64_t next = 0, gap;
+  while(readULEB128(P, E, gap)) {
+    if(gap == 0) return true;
+    next += gap;
+    if(next > Size) return false;
+    S.insert(next - 1);
+  }
+  return false;
+}
+
+void StrictRelations::VariableTable::writeRelations(raw_ostream &OS) {
+  for(VarId v = 0, e = size(); v != e; ++v) {
+    writeSet(lt[v], OS);
+    writeSet(gt[v], OS);
+  }
+}
+
+bool StrictRelations::VariableTable::readRelations(StringRef Data) {
+  const uint8_t *P = (const uint8_t*)Data.data();
+  const uint8_t *E = P + Data.size();
+  bool ok = true;
+  for(VarId v = 0, e = size(); v != e and ok; ++v)
+    ok = readSet(lt[v], e, P, E) and readSet(gt[v], e, P, E);
+  if(ok and P == E) return true;
+  for(VarId v = 0, e = size(); v != e; ++v) {
+    lt[v].clear();
+    gt[v].clear();
+  }
+  return false;
+}
+
+void StrictRelations::VariableTable::printStrictRelations(VarId v,
+                                                          raw_ostream &OS) {
+    printValue(values[v], OS);
     OS << "\nLT: {";
-    if(LT.empty()) OS << "E";
-    for(auto j : LT) {
-      if(j->v->getValueName() == NULL) OS << *(j->v);
-      else OS << j->v->getName();
-      OS << "; ";
+    if(LT(v).empty()) OS << "E";
+    for(auto j : LT(v)) {
+      // j stands for every variable collapsed into it
+      VarId k = j;
+      do {
+        if(rep[k] == j) {
+          printValue(values[k], OS);
+          OS << "; ";
+        }
+        k = mustalias.getNext(k);
+      } while(k != j);
     }
     OS << "}\nGT: {";
-    if(GT.empty()) OS << "E";
-    for(auto j : GT) {
-      if(j->v->getValueName() == NULL) OS << *(j->v);
-      else OS << j->v->getName();
-      OS << "; ";
+    if(GT(v).empty()) OS << "E";
+    for(auto j : GT(v)) {
+      VarId k = j;
+      do {
+        if(rep[k] == j) {
+          printValue(values[k], OS);
+          OS << "; ";
+        }
+        k = mustalias.getNext(k);
+      } while(k != j);
     }
     OS << "}\n";
 }
@@ -1,14 +1,23 @@
 #ifndef __StrictRelationsAliasAnalysis_H__
 #define __StrictRelationsAliasAnalysis_H__
 
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/SmallBitVector.h"
+#include "llvm/ADT/SmallVector.h"
 #include "llvm/ADT/SparseBitVector.h"
+#include "llvm/Support/Allocator.h"
 #include "llvm/Analysis/AliasAnalysis.h"
 #include "llvm/Analysis/Passes.h"
+#include "llvm/IR/PassManager.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Pass.h"
 
 #include "../RangeAnalysis/RangeAnalysis.h"
 
+#include <algorithm>
+#include <functional>
 #include <queue>
 #include <set>
 #include <unordered_set>
@@ -16,82 +25,64 @@
 #include <map>
 #include <utility>
 #include <iterator> 
+#include <memory>
 
 typedef InterProceduralRA<Cousot> InterProceduralRACousot;
 
-namespace {
+// Not anonymous, so that other translation units can use the analysis
+namespace sraa {
 
 ////////////////////////////////////////////////////////////////////////////////
 // Representation of types as sequences of primitive values (now bits!)
 class Primitives {
   public:
-  //Holds a Primitive Layout for a determined Type
+  //Holds a Primitive Layout for a determined Type: the number of primitives
+  //of each element, as prefix sums. Arrays and vectors have the same number
+  //in every element, and keep only that number.
   struct PrimitiveLayout {
-    Type * type;
-    std::vector<int> layout;
-    PrimitiveLayout(Type* ty, std::vector<int> lay) {
-      type = ty;
-      layout = lay;
+    unsigned numElements;
+    int elementSize;
+    // Empty for uniform layouts; otherwise prefix[i] sums elements [0, i)
+    std::vector<int> prefix;
+    //Returns the number of primitives before the ith element
+    int getSumBehind(unsigned int i) const {
+      if(i > numElements)
+        i = numElements;
+      return prefix.empty() ? (int)i * elementSize : prefix[i];
     }
   };
-  struct NumPrimitive {
-    Type * type;
-    int num;
-    NumPrimitive(Type* ty, int n) {
-      type = ty;
-      num = n;
-    }
-  };
-  std::vector<PrimitiveLayout*> PrimitiveLayouts;
-  std::vector<NumPrimitive*> NumPrimitives;
-  std::vector<int> getPrimitiveLayout(Type* type);
+  DenseMap<Type*, PrimitiveLayout> PrimitiveLayouts;
+  DenseMap<Type*, int> NumPrimitives;
+  // The reference is valid until the next call
+  const PrimitiveLayout &getPrimitiveLayout(Type* type);
   int getNumPrimitives(Type* type);
   llvm::Type* getTypeInside(Type* type, int i);
-  int getSumBehind(std::vector<int> v, unsigned int i);
 };
 ////////////////////////////////////////////////////////////////////////////////
 
 //Forward declarations
 class WorkListEngine;
 class Constraint;
-
-void* global_variable_translator;
-
-template <class V> class BitVectorPositionTranslator {
-  std::unordered_map<V, int> v_to_i;
-  std::unordered_map<int, V> i_to_v;
-  unsigned next_i;
-  
-  public:
-  bool addValue(V v) {
-    if(!v_to_i.count(v)) {
-      v_to_i[v] = next_i;
-      i_to_v[next_i] = v;
-      ++next_i;
-      return true;
-    } else {
-      return false;
-    }
-  }
-  
-  unsigned getPosition(V v) {
-    if(!(v_to_i.count(v))) addValue(v);
-    return v_to_i[v];
-  }
-  
-  V getValue(unsigned i) {
-    if(i_to_v.count(i)) return i_to_v[i];
-    else return NULL;
-  }
-    
-};
+class ConstraintKernel;
+class AnalysisArena;
+class ConstraintArena;
 
 class StrictRelations : public ModulePass, public AliasAnalysis {
 
 public:
   ~StrictRelations();
   static char ID; // Class identification, replacement for typeinfo
-  StrictRelations() : ModulePass(ID){}
+  // Without ReportTiming, the owner reports the profile of the analysis
+  StrictRelations(bool ReportTiming = true)
+      : ModulePass(ID), scope(NULL), wle(NULL), kernel(NULL), arena(NULL),
+        constraintArena(NULL), frozen(false), partialGraph(false),
+        reportTiming(ReportTiming) {
+    noAliasCount[0] = noAliasCount[1] = noAliasCount[2] = 0;
+    testLatency[0] = &prof.getHistogram("Test 1");
+    testLatency[1] = &prof.getHistogram("Test 2");
+    testLatency[2] = &prof.getHistogram("Test 3");
+    batchLatency = &prof.getHistogram("Batch");
+  }
 
   /// getAdjustedAnalysisPointer - This method is used when a pass implements
   /// an analysis interface through multiple inheritance.  If needed, it
@@ -103,149 +94,240 @@ public:
     return this;
   }
   
-  struct Variable;
+  // Variables are numbered densely, in the order they are first seen during
+  // constraint collection. Every per-variable datum is stored in arrays indexed
+  // by this number, so the solver never needs to hash a Value.
+  typedef unsigned VarId;
   
-  class VariableSet {
-    friend class VariableSetIterator;
-    
-    BitVectorPositionTranslator<Variable*>* trans;
-    SparseBitVector<> set;
-    unsigned int size;
+  // Disjoint sets of the numbers 0..size()-1, with path compression and union
+  // by rank; find() gives the canonical id of a set. The members of each set
+  // also form a ring through next, so a set can be listed without keeping
+  // a container per set.
+  class UnionFind {
+    std::vector<unsigned> parent;
+    std::vector<unsigned> next;
+    std::vector<unsigned char> rank;
     
-    class VariableSetIterator { 
-      SparseBitVector<>::iterator it;
-      VariableSet* owner;
-      public:
-      // Preincrement.
-      inline VariableSetIterator& operator++() {
-        ++it;
-        return *this;
-      }
-   
-      // Postincrement.
-      inline VariableSetIterator operator++(int) {
-        VariableSetIterator tmp = *this;
-        ++*this;
-        return tmp;
-      }
-   
-      // Return the current set bit number.
-      Variable* operator*() const {
-        return owner->trans->getValue(*it);
-      }
-   
-      bool operator==(const VariableSetIterator &RHS) const {
-        return it == RHS.it;
-      }
-   
-      bool operator!=(const VariableSetIterator &RHS) const {
-        return it != RHS.it;
-      }
-      
-      VariableSetIterator() {
+    public:
+    // Adds a new singleton set and returns its number
+    unsigned add() {
+      unsigned x = parent.size();
+      parent.push_back(x);
+      next.push_back(x);
+      rank.push_back(0);
+      return x;
+    }
+    unsigned find(unsigned x) {
+      unsigned r = x;
+      while(parent[r] != r) r = parent[r];
+      while(parent[x] != r) {
+        unsigned p = parent[x];
+        parent[x] = r;
+        x = p;
       }
-   
-      VariableSetIterator(SparseBitVector<>::iterator It, VariableSet* Owner){
-        it = It;
-        owner = Owner;
+      return r;
+    }
+    void join(unsigned x, unsigned y) {
+      x = find(x);
+      y = find(y);
+      if(x == y) return;
+      if(rank[x] < rank[y]) std::swap(x, y);
+      parent[y] = x;
+      if(rank[x] == rank[y]) rank[x]++;
+      // Splicing two rings is a swap of their next links
+      std::swap(next[x], next[y]);
+    }
+    // The member after x in its set; the ring wraps around to x
+    unsigned getNext(unsigned x) const { return next[x]; }
+    unsigned size() const { return parent.size(); }
+    void clear() { parent.clear(); next.clear(); rank.clear(); }
+    // Makes every number a singleton set again
+    void reset() {
+      for(unsigned x = 0, e = parent.size(); x != e; ++x) {
+        parent[x] = x;
+        next[x] = x;
+        rank[x] = 0;
       }
-    };
+    }
+  };
+
+  class VariableSet {
+    SparseBitVector<> set;
     
     public:
-    typedef VariableSetIterator iterator;
+    typedef SparseBitVector<>::iterator iterator;
     
-    void insert(Variable* v) {
-      trans->addValue(v);
-      set.set(trans->getPosition(v));
-    }
-    int count(Variable* v) {
-      trans->addValue(v);
-      if(set.test(trans->getPosition(v))) return 1;
+    void insert(VarId v) { set.set(v); }
+    int count(VarId v) {
+      if(set.test(v)) return 1;
       else return 0; 
     }
     
-    iterator begin() {
-      return iterator(set.begin(), this);
-    }
-    
-    iterator end() {
-      return iterator(set.end(), this);
-    }
-    
-    void erase(Variable* v) {
-      trans->addValue(v);
-      set.reset(trans->getPosition(v));
-    }
+    iterator begin() { return set.begin(); }
+    iterator end() { return set.end(); }
     
-    VariableSet() {
-      trans = (BitVectorPositionTranslator<Variable*>*) global_variable_translator;
-    }
+    void erase(VarId v) { set.reset(v); }
     
     bool empty() {return set.empty();}
     
     bool intersects (const VariableSet &Other) {
       return set.intersects(Other.set);
     }
+    
+    void clear() { set.clear(); }
+    
+    // Word-parallel operations; they return true if this set changed
+    bool unionWith(const VariableSet &Other) { return set |= Other.set; }
+    bool intersectWith(const VariableSet &Other) { return set &= Other.set; }
+    // This set becomes A \ B
+    void difference(const VariableSet &A, const VariableSet &B) {
+      set.intersectWithComplement(A.set, B.set);
+    }
   
   };
   
-  struct Variable {
-    const Value* v;
-    VariableSet LT;
-    VariableSet GT;
-    std::unordered_set<Constraint*> constraints;
-    Variable(const Value* V) : v(V) { 
-      mustalias = new std::unordered_set<Variable*>();
-      mustalias->insert(this);  
+  // Dense variable store: struct-of-arrays holding the value, the strict
+  // relations and the constraints of each variable.
+  class VariableTable {
+    std::vector<const Value*> values;
+    std::vector<VariableSet> lt;
+    std::vector<VariableSet> gt;
+    std::vector< SmallVector<Constraint*, 4> > constraints;
+    // must alias information, and the joins that built it, so that the
+    // classes can be built again when variables are retired
+    UnionFind mustalias;
+    std::vector< std::pair<VarId, VarId> > joins;
+    // Representative of each variable. Collapsed variables share the strict
+    // relations of their representative, and only representatives appear
+    // inside the LT and GT sets.
+    std::vector<VarId> rep;
+    // Only used to find the variable of a value, never by the solver
+    DenseMap<const Value*, VarId> ids;
+    
+    public:
+    void clear();
+    
+    VarId getOrInsert(const Value* V);
+    bool count(const Value* V) const { return ids.count(V); }
+    VarId lookup(const Value* V) const {
+      assert(ids.count(V) && "Value has no variable");
+      return ids.lookup(V);
     }
+    unsigned size() const { return values.size(); }
     
-    void printStrictRelations(raw_ostream &OS);
+    const Value* getValue(VarId v) const { return values[v]; }
+    VarId find(VarId v) const { return rep[v]; }
+    VariableSet &LT(VarId v) { return lt[rep[v]]; }
+    VariableSet &GT(VarId v) { return gt[rep[v]]; }
+    // Tells if v < w (resp. v > w) is known
+    bool isLT(VarId v, VarId w) { return gt[rep[v]].count(rep[w]); }
+    bool isGT(VarId v, VarId w) { return lt[rep[v]].count(rep[w]); }
+    ArrayRef<Constraint*> getConstraints(VarId v) const {
+      return constraints[v];
+    }
+    void addConstraint(VarId v, Constraint* c);
+    void removeConstraints(VarId v, const DenseSet<const Constraint*> &Dead);
+    // Forgets the value of v. The number is not reused; the variable is left
+    // without relations and constraints.
+    void retire(VarId v);
+    bool isRetired(VarId v) const { return values[v] == NULL; }
+    // Must alias classes: a canonical member, and the next member in the
+    // class of v, wrapping around to v
+    VarId findMustAlias(VarId v) { return mustalias.find(v); }
+    VarId nextMustAlias(VarId v) const { return mustalias.getNext(v); }
+    void coalesce(VarId v, VarId other) {
+      mustalias.join(v, other);
+      joins.push_back(std::make_pair(v, other));
+    }
+    // Builds the must alias classes again from the joins of live variables
+    void rebuildMustAlias();
+    // Drops what only the solver needs: the strict relations, which the
+    // caller keeps elsewhere, the constraints and the must alias classes.
+    // Variables keep their numbers, values and representatives.
+    void freeze();
+    // Makes room for them again, with no relations, constraints or joins
+    void thaw();
+    // Makes r the representative of v. Must be called before solving.
+    void collapse(VarId v, VarId r);
     
-    // must alias information
-    std::unordered_set<Variable*>* mustalias;
-    void coalesce (Variable*);
+    void printStrictRelations(VarId v, raw_ostream &OS);
+    // The strict relations of every variable, in a compact binary form.
+    // Reading fails, and leaves no relations, if the data was not written
+    // for a table of this size.
+    void writeRelations(raw_ostream &OS);
+    bool readRelations(StringRef Data);
   };
      
   //Forward declarations
-  class DepEdge;
+  struct DepNode;
+  struct DepEdge;
+  
+  // Sum of the offset ranges along a path, kept exact: finite bounds are
+  // added in a wider integer and infinite bounds are counted apart, so that
+  // the sum of a sub-path is the difference of two sums. mag adds up the
+  // magnitudes of the finite bounds; while it stays below Max no partial sum
+  // can saturate, and the difference gives the same Range as adding the
+  // edges one by one.
+  struct PathSum {
+    APInt lower, upper, mag;
+    unsigned lowerInf, upperInf;
+    
+    PathSum();
+    PathSum(const Range &R);
+    PathSum operator+(const PathSum &Other) const;
+    PathSum operator-(const PathSum &Other) const;
+    // Returns false if the sum may have saturated
+    bool getRange(Range &R) const;
+  };
 
   struct DepNode {
     const Value* v;
-    std::unordered_set<DepEdge*> inedges;
-    std::unordered_set<DepEdge*> outedges;
+    SmallVector<DepEdge*, 2> inedges;
+    SmallVector<DepEdge*, 2> outedges;
     //Types
     bool arg;
     bool unk;
     bool global;
     bool alloca;
     bool call;
-    std::unordered_set<const Value*> locs;
+    // Set for arguments that a call does not pass; they stay unknown when
+    // the types are found again
+    bool missingArg;
+    // Allocation sites that reach this node, numbered in allocSites
+    SparseBitVector<> locs;
     
-    DepNode(const Value* V) : v(V) {
+    // Id numbers the node in the must alias classes
+    DepNode(const Value* V, unsigned Id) : v(V), id(Id) {
       arg = false; unk = false; global = false; call = false; alloca = false;
-      mustalias = new std::unordered_set<DepNode*>();
-      mustalias->insert(this);
+      missingArg = false;
+      local_root = NULL; up = NULL; top = NULL; jump = NULL;
+      depth = 0; cyclePos = 0;
     }
     
-    static void addEdge(DepNode* in, DepNode* out, Range r){
-      DepEdge* e = new DepEdge(in, out, r);
-      in->inedges.insert(e);
-      out->outedges.insert(e);  
-    }
-    static void addEdge(DepNode* in, DepNode* out, Range r, const Value* o) {
-      DepEdge* e = new DepEdge(in, out, r, o);
-      in->inedges.insert(e);
-      out->outedges.insert(e); 
-    }
+    static DepEdge* addEdge(AnalysisArena &A, DepNode* in, DepNode* out,
+                            Range r, const Value* o = NULL);
   
-    // function and structures for the local analysis
+    // Structures for the local analysis. Nodes with a single in-edge form a
+    // forest, following the edge: the parent of a node is the target of its
+    // single in-edge. A component may end in a cycle, in which case each
+    // cycle node is the top of the tree that hangs from it.
     DepNode *local_root;
-    std::map< DepNode*, std::pair<int, Range> > path_to_root;
-    void getPathToRoot();
+    // The single in-edge, if any
+    DepEdge *up;
+    // Root of this node's tree, or the cycle node the tree hangs from
+    DepNode *top;
+    // Myers' jump pointer: ancestors in O(log depth) with O(1) memory
+    DepNode *jump;
+    unsigned depth;
+    // Offsets from this node to top
+    PathSum sum;
+    // For cycle nodes: position in the cycle and offsets from the first
+    // cycle node; cycleTotal is the offset all around the cycle
+    unsigned cyclePos;
+    PathSum cycleSum, cycleTotal;
     
-    // must alias information
-    std::unordered_set<DepNode*>* mustalias;
-    void coalesce (DepNode*);
+    // must alias information: the number of the node in nodeClasses
+    const unsigned id;
     
   };
   
@@ -259,147 +341,638 @@ public:
     const Value* Offset = NULL) : 
       in(In), out(Out), range(R), offset(Offset) { }
       
+    // Unlinks the edge, if it is still linked; its memory goes away with the
+    // arena
     static void deleteEdge(DepEdge* e){
-      e->in->inedges.erase(e);
-      e->out->outedges.erase(e);
-      delete e;  
+      auto i = std::find(e->in->inedges.begin(), e->in->inedges.end(), e);
+      if(i == e->in->inedges.end()) return;
+      e->in->inedges.erase(i);
+      e->out->outedges.erase(std::find(e->out->outedges.begin(),
+                                       e->out->outedges.end(), e));
     }
   };
 
 
-  Variable* getVariable(Value * V) {
-    if(variables.count(V)) return variables.at(V);
-    else return NULL;
-  }
   void printAllStrictRelations(raw_ostream &OS);
+  
+  // NoAlias verdicts for pairs of must alias classes: the number of the test
+  // that proved them. Other verdicts are not kept, since the members of a
+  // class may differ in what the tests look at (GEP indices, types and
+  // allocation sites), and another pair of members may still be proved
+  // NoAlias. Two generations approximate LRU within a bounded number of
+  // entries: when the young one is full, the old one is dropped and the young
+  // one takes its place; hits in the old generation are moved back to the
+  // young one.
+  class QueryCache {
+    typedef std::pair<unsigned, unsigned> Key;
+    DenseMap<Key, unsigned char> young, old;
+    unsigned capacity;
+    
+    static Key getKey(unsigned A, unsigned B) {
+      return A < B ? std::make_pair(A, B) : std::make_pair(B, A);
+    }
+    
+    public:
+    QueryCache() : capacity(0) {}
+    void setCapacity(unsigned N) { capacity = N; }
+    // Returns true and sets Test if the pair is known NoAlias
+    bool lookup(unsigned A, unsigned B, unsigned &Test);
+    void insert(unsigned A, unsigned B, unsigned Test);
+    void clear() { young.clear(); old.clear(); }
+  };
+  
+  // Read-only form of what the queries need, built by freeze() once the
+  // constraints are solved. Values with a node or a variable are sorted by
+  // address and numbered by their position; every datum of a value is in a
+  // flat array indexed by that number. The strict relations of each
+  // representative variable are a sorted row of one array per relation.
+  class QueryIndex {
+    std::vector<const Value*> values;
+    std::vector<VarId> ltData, gtData;
+    // The row of v is [begin[v], begin[v + 1])
+    std::vector<unsigned> ltBegin, gtBegin;
+    
+    static bool inRow(const std::vector<VarId> &Data,
+                      const std::vector<unsigned> &Begin, VarId v, VarId w) {
+      return std::binary_search(Data.begin() + Begin[v],
+                                Data.begin() + Begin[v + 1], w);
+    }
+    
+    public:
+    static const unsigned None = ~0u;
+    enum { UnkFlag = 1, ArgFlag = 2, GlobalFlag = 4, NoOriginFlag = 8 };
+    // Node, must alias class, flags and allocation sites of each value;
+    // NULL nodes for values without one
+    std::vector<DepNode*> node;
+    std::vector<unsigned> cls;
+    std::vector<unsigned char> flags;
+    std::vector< SparseBitVector<> > locs;
+    // Representative variable of each value, or None
+    std::vector<VarId> var;
+    
+    // Returns the number of V, or None
+    unsigned lookup(const Value* V) const {
+      auto it = std::lower_bound(values.begin(), values.end(), V);
+      if(it == values.end() or *it != V) return None;
+      return it - values.begin();
+    }
+    unsigned size() const { return values.size(); }
+    const Value* getValue(unsigned i) const { return values[i]; }
+    void setValues(std::vector<const Value*> &&Values);
+    // Appends the row of the next variable; rows must be added in order
+    void addRow(VariableSet &LT, VariableSet &GT);
+    // Tells if v < w (resp. v > w) is known, for representatives
+    bool isLT(VarId v, VarId w) const { return inRow(gtData, gtBegin, v, w); }
+    bool isGT(VarId v, VarId w) const { return inRow(ltData, ltBegin, v, w); }
+    ArrayRef<VarId> LT(VarId v) const {
+      return makeArrayRef(ltData).slice(ltBegin[v], ltBegin[v + 1] - ltBegin[v]);
+    }
+    ArrayRef<VarId> GT(VarId v) const {
+      return makeArrayRef(gtData).slice(gtBegin[v], gtBegin[v + 1] - gtBegin[v]);
+    }
+    void clear();
+  };
  
 
-  InterProceduralRACousot *RA;
-  std::unordered_map<const Value*, Variable*> variables;
+  RangeAnalysis *RA;
+  // The only function analysed, or NULL for the whole module
+  Function *scope;
+  VariableTable variables;
   std::unordered_map<const Value*, DepNode*> nodes;
+  // Must alias classes of the nodes, by DepNode::id
+  UnionFind nodeClasses;
+  // Allocation sites, indexed by the numbers used in DepNode::locs
+  std::vector<const Value*> allocSites;
   WorkListEngine* wle;
+  QueryCache cache;
+  // Only kept after runOnModule in lazy mode, to solve on demand
+  ConstraintKernel* kernel;
+  // The nodes and edges of the module, and apart its constraints
+  AnalysisArena* arena;
+  ConstraintArena* constraintArena;
+  // Once frozen, queries only read the index; the nodes stay in the arena
+  // for test 1
+  QueryIndex index;
+  bool frozen;
+  
+  // What each function added to the analysis, so that it can be retracted
+  // when the function changes: its constraints, the variables and nodes of
+  // its arguments and instructions, and the edges of other functions' nodes
+  // that come from its code (argument edges of its calls, and the edges of
+  // the calls to it). Once freeze() frees the constraints, touched keeps the
+  // variables they used.
+  struct FunctionInfo {
+    std::vector<const Constraint*> constraints;
+    std::vector<VarId> touched;
+    std::vector<VarId> vars;
+    std::vector<DepNode*> nodes;
+    std::vector<DepEdge*> edges;
+  };
+  DenseMap<const Function*, FunctionInfo> functions;
+  // The joins that built nodeClasses, replayed when nodes are retracted
+  std::vector< std::pair<DepNode*, DepNode*> > nodeJoins;
+  // Set when buildDepGraph stopped at a call with too few arguments. Which
+  // edges such a graph has depends on the order of the nodes, so updates
+  // build it whole again.
+  bool partialGraph;
             
   void getAnalysisUsage(AnalysisUsage &AU) const override;
+  void releaseMemory() override;
   
   AliasResult alias(const MemoryLocation &LocA,
                               const MemoryLocation &LocB) override;
+  // The answer of the three tests alone: MayAlias when they prove nothing,
+  // without asking the next analysis in the chain
+  AliasResult getAliasResult(const MemoryLocation &LocA,
+                             const MemoryLocation &LocB);
+  // Bit i is set if getAliasResult(Loc, Others[i]) would be NoAlias. The
+  // pointer of Loc is looked up once, and its strict relations are matched
+  // against the variables of all the others in one pass over each set.
+  SmallBitVector aliasMany(const MemoryLocation &Loc,
+                           ArrayRef<MemoryLocation> Others);
+  const Profile &getProfile() const { return prof; }
+  // NoAlias answers given by the test, from 1 to 3, cache hits included.
+  // Unlike the statistics, they are counted in every build.
+  unsigned getNumNoAlias(unsigned Test) const {
+    return noAliasCount[Test - 1];
+  }
   bool runOnModule(Module &M) override;
+  // Analyses the module with the given ranges; runOnModule gets them from
+  // the legacy pass manager, StrictRelationsAnalysis from the new one. With
+  // a Scope, only that function is analysed: its arguments and the globals
+  // are roots of the dependence graph, and calls are not linked to the
+  // returns of the called functions.
+  void analyze(Module &M, RangeAnalysis &R, Function *Scope = NULL);
+  
+  // Brings the analysis up to date after the functions in Changed were
+  // modified or deleted; deleted functions must be gone from M. What they
+  // added is retracted, the ones still in M are collected again, and only
+  // the components of the constraint graph that they touch are solved
+  // again. Ranges still come from the InterProceduralRA the pass ran with.
+  void updateFunctions(Module &M, ArrayRef<const Function*> Changed);
+  
+  // Builds the query index and frees what only the solver needs: the
+  // constraints, the strict relations of the variable table, which move to
+  // the index, and the map from values to nodes. Nothing is done in lazy
+  // mode, where queries still solve constraints. Updates thaw the analysis
+  // and freeze it again.
+  void freeze();
 
 private:  
 
-  bool aliastest1(const Value* p1, const Value* p2);
-  bool aliastest2(const Value* p1, const Value* p2);
-  bool aliastest3(const Value* p1, const Value* p2);
+  unsigned noAliasCount[3];
+  void countNoAlias(unsigned Test);
+  // Answers the queries of -aa-eval as -sraa-verify asks, and prints the
+  // pairs of pointers where the verdicts differ from those of getAliasResult
+  void verify(Module &M);
+  // Undoes freeze() before an update: the nodes and the relations come back
+  // from the index, and the constraints of the functions that are not in
+  // Changed are collected again
+  void thaw(Module &M, ArrayRef<const Function*> Changed);
+  
+  // What the tests need to know about a queried pointer
+  struct QueryPointer {
+    const Value* v;
+    DepNode* node;
+    // Must alias class of the node
+    unsigned cls;
+    // QueryIndex flags and allocation sites of the node
+    unsigned char flags;
+    const SparseBitVector<> *locs;
+    bool hasVar;
+    VarId var;
+    // For GEPs whose base has a node, the must alias class of the base
+    const GetElementPtrInst* gep;
+    unsigned baseCls;
+  };
+  // False if the pointer has no node
+  bool resolve(const Value* V, QueryPointer &Q);
+  // Variables and their strict relations, from the index once frozen
+  bool lookupVar(const Value* V, VarId &v);
+  VarId getRep(VarId v) { return frozen ? v : variables.find(v); }
+  bool isLT(VarId v, VarId w) {
+    return frozen ? index.isLT(v, w) : variables.isLT(v, w);
+  }
+  bool isGT(VarId v, VarId w) {
+    return frozen ? index.isGT(v, w) : variables.isGT(v, w);
+  }
+  // Related becomes the members of Candidates, which must be
+  // representatives, that v is known to be less or greater than
+  void findRelated(VarId v, VariableSet &Candidates, VariableSet &Related);
+  
+  bool aliastest1(const QueryPointer &Q1, const QueryPointer &Q2);
+  bool aliastest2(const QueryPointer &Q1, const QueryPointer &Q2);
+  bool aliastest3(const QueryPointer &Q1, const QueryPointer &Q2);
+  // The part of test 2 about GEPs of the same base
+  bool disjointBases(const QueryPointer &Q1, const QueryPointer &Q2);
   
   enum CompareResult {L, G, E, N};
   CompareResult compareValues(const Value*, const Value*);
+  // In lazy mode, solves the constraints the variable depends on
+  void solveFor(VarId v);
   bool disjointGEPs(const GetElementPtrInst*, const GetElementPtrInst*);
   
   // Phases
+  void analyzeModule(Module &M);
+  // Solved relations kept in the cache directory, in a file named after a
+  // hash of the module
+  std::string getResultsPath(Module &M);
+  bool loadRelations(StringRef Path);
+  void saveRelations(StringRef Path);
   Range processGEP(const Value*, const Use*, const Use*);
   void collectConstraintsFromModule(Module &M);
+  void collectConstraintsFromFunction(Function &F);
+  template <class C> void addConstraint(const Value* L, const Value* R);
+  DepNode* newNode(const Value* V);
+  DepNode* getOrCreateNode(const Value* V);
+  void joinNodes(DepNode* A, DepNode* B);
   void buildDepGraph(Module &M);
+  // Edges out of n; false if a call has too few arguments for n
+  bool addEdges(DepNode* n);
+  bool addArgumentEdge(DepNode* n, const Argument* A, const CallInst* Caller);
+  void addCallEdges(DepNode* n, const CallInst* C);
+  void retractFunction(const Function* F, DenseSet<const Constraint*> &Dead,
+                       DenseSet<DepNode*> &DeadNodes);
   void collectTypes();
   void propagateTypes();
-  void propagateArgs(std::set<DepNode*> &args);
-  void propagateGlobals(std::set<DepNode*> &globals);
-  void propagateUnks(std::set<DepNode*> &unks);
-  void propagateAlloca(DepNode*);
-
-  //Times
-  float phase1;
-  float phase2;
-  float phase3;
-  float phases;
-  float test1;
-  float test2;
-  float test3;
-
-  static Primitives P;
+  void buildForest();
+  DepNode* getCommonAncestor(DepNode*, DepNode*);
+
+  // Wall time and memory of the phases, and latencies of the tests
+  Profile prof;
+  Profile::Histogram *testLatency[3];
+  Profile::Histogram *batchLatency;
+  bool reportTiming;
+  
+  // Queries written by -sraa-record-trace, with the scope and index that
+  // name each value of the module in the trace
+  std::unique_ptr<raw_fd_ostream> trace;
+  DenseMap<const Value*, std::pair<unsigned, unsigned> > traceIds;
+  void openTrace(Module &M);
+  void recordQuery(const MemoryLocation &LocA, const MemoryLocation &LocB,
+                   AliasResult R);
+
+  Primitives P;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Strict relations of one function at a time, with the ranges of
+// IntraProceduralRA, for pipelines made of function passes. Each function is
+// analysed on its own, by its own StrictRelations object.
+class FunctionStrictRelations : public FunctionPass, public AliasAnalysis {
+  std::unique_ptr<StrictRelations> SR;
+  // Timings of the functions analysed so far, reported once at the end
+  Profile prof;
+  
+  // Drops the analysis of the last function, keeping its timings
+  void releaseAnalysis();
+  
+public:
+  static char ID;
+  FunctionStrictRelations() : FunctionPass(ID) {}
+  
+  virtual void *getAdjustedAnalysisPointer(AnalysisID PI) override {
+    if (PI == &AliasAnalysis::ID)
+      return (AliasAnalysis*)this;
+    return this;
+  }
+  
+  void getAnalysisUsage(AnalysisUsage &AU) const override;
+  void releaseMemory() override { releaseAnalysis(); }
+  bool runOnFunction(Function &F) override;
+  bool doFinalization(Module &M) override;
+  AliasResult alias(const MemoryLocation &LocA,
+                    const MemoryLocation &LocB) override;
+  SmallBitVector aliasMany(const MemoryLocation &Loc,
+                           ArrayRef<MemoryLocation> Others) {
+    return SR ? SR->aliasMany(Loc, Others) : SmallBitVector(Others.size());
+  }
+};
+////////////////////////////////////////////////////////////////////////////////
+// Replays the queries of a trace written by -sraa-record-trace through the
+// alias analysis in use, and reports how many it answers per second and,
+// when it is -sraa, which tests answered them. The module must be the one
+// the trace was recorded on, as it was when the alias analysis ran.
+class AliasTraceReplay : public ModulePass {
+public:
+  static char ID;
+  AliasTraceReplay() : ModulePass(ID) {}
+  
+  void getAnalysisUsage(AnalysisUsage &AU) const override;
+  bool runOnModule(Module &M) override;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// StrictRelations as an analysis of the new pass manager. The result lives
+// in the analysis manager until a pass preserves neither it nor the ranges
+// it was built from.
+class StrictRelationsAnalysis {
+public:
+  class Result {
+    std::unique_ptr<StrictRelations> SR;
+  
+  public:
+    explicit Result(std::unique_ptr<StrictRelations> SR) : SR(std::move(SR)) {}
+    Result(Result &&Other) : SR(std::move(Other.SR)) {}
+    
+    AliasResult alias(const MemoryLocation &LocA, const MemoryLocation &LocB) {
+      return SR->getAliasResult(LocA, LocB);
+    }
+    StrictRelations &getStrictRelations() { return *SR; }
+    bool invalidate(Module &M, const PreservedAnalyses &PA);
+  };
+  
+  static void *ID() { return (void*)&PassID; }
+  static StringRef name() { return "StrictRelationsAnalysis"; }
+  Result run(Module &M, ModuleAnalysisManager *AM);
+  
+private:
+  static char PassID;
 };
 ////////////////////////////////////////////////////////////////////////////////
 
 //Worklist engine declarations
 class Constraint;
+class ConstraintKernel;
+
+// FIFO worklist split in ranks. Elements of the lowest pending rank are
+// always popped first; elements of the same rank come out in FIFO order.
+// With a single rank this is a plain FIFO queue.
+template <class T> class RankedWorkList {
+  std::vector< std::queue<T> > buckets;
+  // Ranks whose bucket is not empty, each one exactly once
+  std::priority_queue<unsigned, std::vector<unsigned>,
+                      std::greater<unsigned> > pending;
+public:
+  RankedWorkList() : buckets(1) {}
+  void setNumRanks(unsigned N) { buckets.resize(N ? N : 1); }
+  bool empty() const { return pending.empty(); }
+  void push(T E, unsigned R) {
+    if(buckets[R].empty()) pending.push(R);
+    buckets[R].push(E);
+  }
+  T pop() {
+    unsigned r = pending.top();
+    T e = buckets[r].front();
+    buckets[r].pop();
+    if(buckets[r].empty()) pending.pop();
+    return e;
+  }
+};
 
 class WorkListEngine {
 public:
+  WorkListEngine(StrictRelations::VariableTable* V) : vars(V), numRanks(1) {}
   void solve();
-  void add(const Constraint*);
+  void add(Constraint*);
+  // Drops the constraints and numbers the others again. Ranks and collapsed
+  // flags are dropped too.
+  void remove(const DenseSet<const Constraint*> &Dead);
+  // Solves starting from the given constraints only
+  void solve(ArrayRef<const Constraint*> Seeds);
   void push(const Constraint*);
+  // Ranks the constraints by the topological order of the strongly connected
+  // components of the variable graph, so that the solver visits a component
+  // only after the components that flow into it.
+  void schedule();
+  unsigned getRank(const Constraint*) const;
+  // Merges the variables of each cycle of <= and == constraints into a
+  // single representative, and drops the constraints inside the cycles.
+  void collapse();
+  bool isCollapsed(const Constraint* C) const;
+  unsigned getNumRanks() const { return numRanks; }
   void printConstraints(raw_ostream &OS);
-  std::unordered_map<const Constraint*, bool> getConstraints() { return constraints; }
+  const std::vector<const Constraint*> &getConstraints() { return constraints; }
   int getNumConstraints() { return constraints.size(); }
+  StrictRelations::VariableTable &getVariables() { return *vars; }
 
-  //WorkListEngine is in charge of constraint deletion
-  ~WorkListEngine();
   
 private:
-  std::queue<const Constraint*> worklist;
-  std::unordered_map<const Constraint*, bool> constraints;
+  StrictRelations::VariableTable* vars;
+  RankedWorkList<const Constraint*> worklist;
+  // Constraints are indexed by their id; queued[id] tells if it is in the
+  // worklist and ranks[id] is its rank, when the engine has been scheduled
+  std::vector<const Constraint*> constraints;
+  std::vector<bool> queued;
+  std::vector<unsigned> ranks;
+  unsigned numRanks;
+  std::vector<bool> collapsed;
 };
 
 class Constraint {
+  friend class WorkListEngine;
 protected:
   WorkListEngine * engine;
+  // Position of this constraint in the engine, which numbers the
+  // constraints again when some are removed
+  mutable unsigned id;
 public:
   virtual void resolve() const =0;
   virtual void print(raw_ostream &OS) const =0;
+  // Adds this constraint to the kernel and returns its handle there
+  virtual unsigned lower(ConstraintKernel &K) const =0;
+  // Edges along which the LT sets flow, and the variable that receives them
+  virtual void getFlow(SmallVectorImpl<std::pair<StrictRelations::VarId,
+                            StrictRelations::VarId> > &Edges) const =0;
+  virtual StrictRelations::VarId getTarget() const =0;
+  // True for the <= and == constraints, whose cycles can be collapsed
+  virtual bool isNonStrict() const { return false; }
+  unsigned getId() const { return id; }
   virtual ~Constraint() {}
 };
 
 ////////////////////////////////////////////////////////////////////////////////
 // Constraint types declaration
 class LT : public Constraint {
-  StrictRelations::Variable * const left, * const right;
+  const StrictRelations::VarId left, right;
 public:
-  LT(WorkListEngine* W, StrictRelations::Variable* L,
-          StrictRelations::Variable* R) : left(L), right(R) { engine = W; };
+  LT(WorkListEngine* W, StrictRelations::VarId L,
+          StrictRelations::VarId R) : left(L), right(R) { engine = W; };
   void resolve() const override;
   void print(raw_ostream &OS) const override;
+  unsigned lower(ConstraintKernel &K) const override;
+  void getFlow(SmallVectorImpl<std::pair<StrictRelations::VarId,
+                          StrictRelations::VarId> > &Edges) const override;
+  StrictRelations::VarId getTarget() const override;
 };
 
 class LE : public Constraint {
-  StrictRelations::Variable * const left, * const right;
+  const StrictRelations::VarId left, right;
 public:
-  LE(WorkListEngine* W, StrictRelations::Variable* L,
-          StrictRelations::Variable* R) : left(L), right(R) { engine = W; };
+  LE(WorkListEngine* W, StrictRelations::VarId L,
+          StrictRelations::VarId R) : left(L), right(R) { engine = W; };
   void resolve() const override;
+  bool isNonStrict() const override { return true; }
   void print(raw_ostream &OS) const override;
+  unsigned lower(ConstraintKernel &K) const override;
+  void getFlow(SmallVectorImpl<std::pair<StrictRelations::VarId,
+                          StrictRelations::VarId> > &Edges) const override;
+  StrictRelations::VarId getTarget() const override;
 };
 
 class REQ : public Constraint {
-  StrictRelations::Variable * const left, * const right;
+  const StrictRelations::VarId left, right;
 public:
-  REQ(WorkListEngine* W, StrictRelations::Variable* L,
-          StrictRelations::Variable* R) : left(L), right(R) { engine = W; };
+  REQ(WorkListEngine* W, StrictRelations::VarId L,
+          StrictRelations::VarId R) : left(L), right(R) { engine = W; };
   void resolve() const override;
+  bool isNonStrict() const override { return true; }
   void print(raw_ostream &OS) const override;
+  unsigned lower(ConstraintKernel &K) const override;
+  void getFlow(SmallVectorImpl<std::pair<StrictRelations::VarId,
+                          StrictRelations::VarId> > &Edges) const override;
+  StrictRelations::VarId getTarget() const override;
 };
 
 class EQ : public Constraint {
-  StrictRelations::Variable * const left, * const right;
+  const StrictRelations::VarId left, right;
 public:
-  EQ(WorkListEngine* W, StrictRelations::Variable* L,
-          StrictRelations::Variable* R) : left(L), right(R) { engine = W; };
+  EQ(WorkListEngine* W, StrictRelations::VarId L,
+          StrictRelations::VarId R) : left(L), right(R) { engine = W; };
   void resolve() const override;
   void print(raw_ostream &OS) const override;
+  unsigned lower(ConstraintKernel &K) const override;
+  void getFlow(SmallVectorImpl<std::pair<StrictRelations::VarId,
+                          StrictRelations::VarId> > &Edges) const override;
+  StrictRelations::VarId getTarget() const override;
 };
 
 class PHI : public Constraint {
-  StrictRelations::Variable * const left;
-  std::unordered_set<StrictRelations::Variable*> operands;
+  const StrictRelations::VarId left;
+  SmallVector<StrictRelations::VarId, 4> operands;
 public:
-  PHI(WorkListEngine* W, StrictRelations::Variable* L,
-                          std::unordered_set<StrictRelations::Variable*> Operands)
-                          : left(L), operands(Operands) { engine = W; };
+  PHI(WorkListEngine* W, StrictRelations::VarId L,
+                          ArrayRef<StrictRelations::VarId> Operands)
+                          : left(L), operands(Operands.begin(), Operands.end())
+                          { engine = W; };
   void resolve() const override;
   void print(raw_ostream &OS) const override;
+  unsigned lower(ConstraintKernel &K) const override;
+  void getFlow(SmallVectorImpl<std::pair<StrictRelations::VarId,
+                          StrictRelations::VarId> > &Edges) const override;
+  StrictRelations::VarId getTarget() const override;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Storage for the objects built while analysing a module. They are created
+// with create<T>(ctor args), never freed one by one, and all go away with
+// the arena.
+class AnalysisArena {
+  SpecificBumpPtrAllocator<StrictRelations::DepNode> DepNodes;
+  SpecificBumpPtrAllocator<StrictRelations::DepEdge> DepEdges;
+  
+  SpecificBumpPtrAllocator<StrictRelations::DepNode> &
+  get(StrictRelations::DepNode*) { return DepNodes; }
+  SpecificBumpPtrAllocator<StrictRelations::DepEdge> &
+  get(StrictRelations::DepEdge*) { return DepEdges; }
+
+public:
+  template <class T, class... ArgTs> T* create(ArgTs&&... Args) {
+    return new (get((T*)nullptr).Allocate()) T(std::forward<ArgTs>(Args)...);
+  }
+};
+
+// The same for the constraints, which are kept apart so that freeze() can
+// free them while test 1 still walks the nodes
+class ConstraintArena {
+  SpecificBumpPtrAllocator<LT> LTs;
+  SpecificBumpPtrAllocator<LE> LEs;
+  SpecificBumpPtrAllocator<REQ> REQs;
+  SpecificBumpPtrAllocator<EQ> EQs;
+  SpecificBumpPtrAllocator<PHI> PHIs;
+  
+  SpecificBumpPtrAllocator<LT> &get(LT*) { return LTs; }
+  SpecificBumpPtrAllocator<LE> &get(LE*) { return LEs; }
+  SpecificBumpPtrAllocator<REQ> &get(REQ*) { return REQs; }
+  SpecificBumpPtrAllocator<EQ> &get(EQ*) { return EQs; }
+  SpecificBumpPtrAllocator<PHI> &get(PHI*) { return PHIs; }
+
+public:
+  template <class T, class... ArgTs> T* create(ArgTs&&... Args) {
+    return new (get((T*)nullptr).Allocate()) T(std::forward<ArgTs>(Args)...);
+  }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Constraint kernel declaration
+// The kernel solves the same system as the WorkListEngine, visiting the
+// constraints in the same order, but without virtual dispatch: constraints
+// are plain records stored in one array per kind, and the set unions are
+// whole-word SparseBitVector operations. It uses the ranks of the engine, if
+// it has been scheduled.
+// Constraints that share no variable cannot affect each other, so the kernel
+// can solve the weakly connected components of the constraint graph on
+// separate threads. Each component is solved in the same order it would be
+// in a sequential run, so the results do not depend on the thread count.
+class ConstraintKernel {
+public:
+  enum Kind { LTKind, LEKind, REQKind, EQKind, PHIKind, NumKinds };
+  typedef StrictRelations::VarId VarId;
+  
+  // Builds the kernel from the constraints held by the engine
+  ConstraintKernel(WorkListEngine &W);
+  unsigned add(Kind K, VarId L, VarId R, unsigned Rank);
+  unsigned addPHI(VarId L, ArrayRef<VarId> Operands, unsigned Rank);
+  void solve(unsigned Threads = 1);
+  // Solves only the component of v, if it was not solved yet. The first call
+  // partitions the constraints.
+  void solveFor(VarId v);
+
+private:
+  // A handle holds the kind in the upper bits and the index in the lower ones
+  static const unsigned KindShift = 29;
+  static Kind getKind(unsigned H) { return (Kind)(H >> KindShift); }
+  static unsigned getIndex(unsigned H) { return H & ((1u << KindShift) - 1); }
+  
+  struct Record {
+    VarId left;
+    // For PHI records, the operands are phiOperands[right, end)
+    VarId right;
+    unsigned end;
+  };
+  
+  // State of one solving thread
+  struct Task {
+    RankedWorkList<unsigned> worklist;
+    // Variables changed by the resolve in progress
+    StrictRelations::VariableSet changed;
+  };
+  
+  StrictRelations::VariableTable* vars;
+  std::vector<Record> records[NumKinds];
+  // Not a vector<bool>: threads write the flags of different constraints
+  std::vector<unsigned char> queued[NumKinds];
+  std::vector<unsigned> ranks[NumKinds];
+  std::vector<VarId> phiOperands;
+  // Handles in the order the engine holds the constraints
+  std::vector<unsigned> order;
+  // Handles of the constraints that use each variable
+  std::vector< SmallVector<unsigned, 4> > uses;
+  unsigned numRanks;
+  
+  // Components of the constraint graph, for solving on demand
+  std::vector< std::vector<unsigned> > components;
+  // Component of each variable, or ~0u if it has no constraints
+  std::vector<unsigned> componentOf;
+  std::vector<bool> solved;
+  
+  // Splits the handles into the weakly connected components of the
+  // constraint graph, largest first, keeping the handle order in each one
+  void partition(std::vector< std::vector<unsigned> > &Components);
+  template <class F> void forEachVariable(unsigned H, F Fn) const;
+  void solve(Task &T, ArrayRef<unsigned> Handles);
+  void push(Task &T, unsigned H);
+  void resolve(Task &T, unsigned H);
+  void resolvePHI(Task &T, const Record &R);
+  void insertLT(Task &T, VarId x, VarId y);
+  void insertGT(Task &T, VarId x, VarId y);
+  void joinLT(Task &T, VarId x, StrictRelations::VariableSet &S);
+  void joinGT(Task &T, VarId x, StrictRelations::VariableSet &S);
 };
 
 ////////////////////////////////////////////////////////////////////////////////
 
-}
+} // end namespace sraa
 
 
 #endif
@@ -0,0 +1,105 @@
+#!/bin/bash
+# Prints a C program of the given family and size.
+# Usage: ./gen.sh gep|phi|ladder|calls|struct N
+#   gep     a chain of N pointers, each one GEP of the previous
+#   phi     a pointer with a phi of N incoming values
+#   ladder  N comparisons in a row, each one with its sigmas
+#   calls   N small functions with pointer arguments, and their calls
+#   struct  a struct of N fields of mixed types, all of them accessed
+family=$1
+n=$2
+if [ -z "$family" ] || [ -z "$n" ]; then
+  echo "usage: $0 gep|phi|ladder|calls|struct N" >&2
+  exit 1
+fi
+
+case $family in
+gep)
+  echo "int gep(int *a, int i) {"
+  echo "  int *p0 = a + i;"
+  for ((k = 1; k < n; k++)); do
+    echo "  int *p$k = p$((k - 1)) + $((k % 7 + 1));"
+  done
+  echo "  int s = 0;"
+  for ((k = 0; k < n; k++)); do
+    echo "  s += *p$k;"
+  done
+  echo "  return s;"
+  echo "}"
+  ;;
+phi)
+  echo "int phi(int *a, int n) {"
+  echo "  int *p = a;"
+  echo "  int s = 0;"
+  echo "  for (int i = 0; i < n; i++) {"
+  echo "    switch (i % $n) {"
+  for ((k = 0; k < n; k++)); do
+    if ((k % 2)); then
+      echo "    case $k: p = p + $k; break;"
+    else
+      echo "    case $k: p = a + $k; break;"
+    fi
+  done
+  echo "    }"
+  echo "    s += *p;"
+  echo "  }"
+  echo "  return s;"
+  echo "}"
+  ;;
+ladder)
+  echo "int ladder(int *a, int *x) {"
+  for ((k = 0; k <= n; k++)); do
+    echo "  int i$k = x[$k];"
+  done
+  echo "  int s = 0;"
+  for ((k = 0; k < n; k++)); do
+    echo "  if (i$k < i$((k + 1)))"
+    echo "    a[i$k] = a[i$((k + 1))] + s++;"
+  done
+  echo "  return s;"
+  echo "}"
+  ;;
+calls)
+  for ((k = 0; k < n; k++)); do
+    echo "int f$k(int *p, int *q) {"
+    echo "  *p = *(q + $((k % 5 + 1)));"
+    echo "  return *(p + 1);"
+    echo "}"
+  done
+  echo "int calls(int *a) {"
+  echo "  int s = 0;"
+  for ((k = 0; k < n; k++)); do
+    echo "  s += f$k(a + $k, a + $((k + 1)));"
+  done
+  echo "  return s;"
+  echo "}"
+  ;;
+struct)
+  echo "struct S {"
+  for ((k = 0; k < n; k++)); do
+    case $((k % 4)) in
+    0) echo "  int f$k;" ;;
+    1) echo "  char f$k[3];" ;;
+    2) echo "  double f$k;" ;;
+    3) echo "  struct { short a; int b[2]; } f$k;" ;;
+    esac
+  done
+  echo "};"
+  echo "int st(struct S *s, int i) {"
+  echo "  int r = 0;"
+  for ((k = 0; k < n; k++)); do
+    case $((k % 4)) in
+    0) echo "  r += s[i].f$k;" ;;
+    1) echo "  r += s[i].f$k[1];" ;;
+    2) echo "  r += (int)s[i].f$k;" ;;
+    3) echo "  r += s[i].f$k.b[1];" ;;
+    esac
+  done
+  echo "  return r;"
+  echo "}"
+  ;;
+*)
+  echo "$0: unknown family '$family'" >&2
+  exit 1
+  ;;
+esac
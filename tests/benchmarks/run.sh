@@ -0,0 +1,76 @@
+#!/bin/bash
+# Runs the range analysis and the strict relations analysis over generated
+# programs of growing size, and prints one CSV line per program:
+#   family, n, number of alias queries, range analysis time, time of each
+#   sraa phase, mean and p99 latency of each alias test, peak memory
+# Times are in seconds, latencies in nanoseconds and memory in KB. The query
+# workload is -aa-eval, over the pointers of every function. Every query
+# that reaches the alias tests runs test 3 first, so its count is the number
+# of queries; the ones answered by the cache are not counted.
+# Afterwards, every phase whose time grows faster than N^1.5 between two
+# sizes is listed.
+# Usage: ./run.sh [family...]; SIZES="100 200 ..." overrides the sizes.
+DIR=$(cd "$(dirname "$0")" && pwd)
+FAMILIES=${@:-gep phi ladder calls struct}
+SIZES=${SIZES:-100 200 400 800 1600}
+WORK=$(mktemp -d)
+trap 'rm -rf $WORK' EXIT
+
+# Value of a field of an object of the JSON timing report
+field() {
+  echo "$1" | sed -E "s/.*\"name\": \"$2\"[^}]*\"$3\": ([0-9]+).*/\1/"
+}
+
+CSV=$WORK/results.csv
+echo "family,n,queries,ra,collection,depgraph,propagation,trees,worklist,test1_mean,test1_p99,test2_mean,test2_p99,test3_mean,test3_p99,peak_kb"
+for family in $FAMILIES; do
+  for n in $SIZES; do
+    P=$WORK/$family$n
+    "$DIR/gen.sh" $family $n > $P.c || exit 1
+    clang -c -emit-llvm $P.c -o $P.bc || exit 1
+    opt -load vSSA.so -mem2reg -instnamer -break-crit-edges -vssa $P.bc \
+      -o $P.essa.bc || exit 1
+    opt -load RangeAnalysis.so -load SRAA.so -sraa -sraa-timing=json \
+      -aa-eval -time-passes $P.essa.bc -o /dev/null > $P.log 2>&1
+
+    json=$(grep '^{"phases"' $P.log | tail -1)
+    queries=$(field "$json" "Test 3" count)
+    # Wall time is the last column of -time-passes
+    ra=$(grep "Range Analysis (Cousot - inter)" $P.log | head -1 |
+         sed -E 's/\( *[0-9.]+%\)//g' | awk '{print $(NF-5)}')
+    line="$family,$n,${queries:-0},${ra:-0}"
+    for phase in "Constraint collection" "Dependence graph" "Propagation" \
+                 "Local trees" "Worklist"; do
+      ns=$(field "$json" "$phase" ns)
+      line="$line,$(awk "BEGIN {print $ns / 1e9}")"
+    done
+    for t in 1 2 3; do
+      count=$(field "$json" "Test $t" count)
+      ns=$(field "$json" "Test $t" ns)
+      p99=$(field "$json" "Test $t" p99_ns)
+      mean=$(awk "BEGIN {print $count ? int($ns / $count) : 0}")
+      line="$line,$mean,$p99"
+    done
+    rss=$(field "$json" "Worklist" peak_rss)
+    line="$line,$((rss / 1024))"
+    echo "$line" | tee -a $CSV
+  done
+done
+
+# Growth exponent of each time column between consecutive sizes; times
+# below 10ms are noise
+awk -F, '
+  BEGIN { split("ra collection depgraph propagation trees worklist", name) }
+  {
+    if ($1 == family) {
+      for (c = 4; c <= 9; c++)
+        if ($c > 0.01 && prev[c] > 0 && $2 > n) {
+          e = log($c / prev[c]) / log($2 / n)
+          if (e > 1.5)
+            printf("super-linear: %s %s from n=%d to n=%d (N^%.2f)\n",
+                   $1, name[c - 3], n, $2, e)
+        }
+    }
+    family = $1; n = $2
+    for (c = 4; c <= 9; c++) prev[c] = $c
+  }' $CSV
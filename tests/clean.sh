@@ -2,3 +2,4 @@
 rm *ll
 rm *dot
 rm *bc
+rm *trace
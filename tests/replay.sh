@@ -0,0 +1,22 @@
+#!/bin/bash
+# Records the alias queries that -O3 asks about a program, then replays them
+# alone, and checks that the replay gives the NoAlias and MayAlias verdicts
+# of the recording. Usage: ./replay.sh program (after ./compile.sh program)
+BC=$1.essa.bc
+opt -load RangeAnalysis.so -load SRAA.so -sraa -sraa-timing=none \
+  -sraa-record-trace=$1.trace -O3 $BC -o /dev/null || exit 1
+opt -load RangeAnalysis.so -load SRAA.so -sraa -sraa-timing=none \
+  -sraa-replay -sraa-replay-trace=$1.trace -stats $BC -o /dev/null 2>&1 |
+  tee $1.replay.txt
+# The replay skips the queries about pointers that -O3 created
+recorded=$(awk '$1 != "-" && $4 != "-" { n[$7]++ }
+  END { printf "NoAlias: %d MayAlias: %d", n["NoAlias"], n["MayAlias"] }' \
+  $1.trace)
+replayed=$(grep -E "^(NoAlias|MayAlias): " $1.replay.txt | tr '\n' ' ' |
+  sed 's/ $//')
+rm -f $1.replay.txt
+if [ "$recorded" != "$replayed" ]; then
+  echo "$1: the replay gives $replayed, the recording $recorded"
+  exit 1
+fi
+echo "$1: the replay gives the verdicts of the recording"
@@ -0,0 +1,34 @@
+#!/bin/bash
+# Checks that the parallel solver, and the parallel construction of the
+# constraint graphs of the range analysis, give the same results as the
+# sequential ones. Usage: ./threads.sh program [threads] (after ./compile.sh
+# program)
+THREADS=${2:-8}
+# Alias verdicts, and the statistics of the range analysis, which count the
+# ranges of each kind
+run() {
+  opt -load RangeAnalysis.so -load SRAA.so -sraa -sraa-timing=none $@ \
+    -aa-eval -print-all-alias-modref-info -stats $BC -o /dev/null 2>&1 |
+    awk '!/^ *[0-9]+ [a-z-]+ +- / || / range-analysis +- /'
+}
+# Usage: compare what sequential-options parallel-options
+compare() {
+  run $2 > $P.seq.txt
+  for i in 1 2 3; do
+    run $3 > $P.par.txt
+    if ! diff -q $P.seq.txt $P.par.txt > /dev/null; then
+      echo "$P: $1 differ with $THREADS threads (run $i)"
+      diff $P.seq.txt $P.par.txt | head -20
+      status=1
+      break
+    fi
+  done
+}
+P=$1
+BC=$P.essa.bc
+status=0
+compare "solver results" -sraa-solver=worklist -sraa-threads=$THREADS
+compare "ranges" -ra-threads=1 -ra-threads=$THREADS
+rm -f $P.seq.txt $P.par.txt
+[ $status -eq 0 ] && echo "$P: parallel results match the sequential ones"
+exit $status
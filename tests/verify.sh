@@ -0,0 +1,15 @@
+#!/bin/bash
+# Checks that another way of answering the queries of -aa-eval gives the
+# verdicts of single queries: batched ones, single ones after updating every
+# function, or the analysis of the new pass manager. Usage: ./verify.sh
+# program batch|updates|newpm [sraa options] (after ./compile.sh program);
+# with -sraa-freeze, the updates thaw the frozen analysis.
+P=$1
+opt -load RangeAnalysis.so -load SRAA.so -sraa -sraa-timing=none \
+  -sraa-verify=$2 ${@:3} $P.essa.bc -o /dev/null 2>&1 | grep "^sraa: " \
+  > $P.verify.txt
+cat $P.verify.txt
+grep -q " 0 mismatches" $P.verify.txt
+status=$?
+rm -f $P.verify.txt
+exit $status